@@ -1,13 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "my_rand.h"
 #include <pthread.h>
 #include "timer.h"
+#include "workload.h"
 
 
 /* Random ints are less than MAX_KEY */
 const int MAX_KEY = 100000000;
 
+#define SCAN_WIDTH 1000000    // Ширина диапазона RangeScan по умолчанию (ключ -s)
+
 /* Struct for list nodes */
 struct list_node_s {
    int    data;
@@ -98,6 +107,136 @@ int rwlock_unlock(rwlock_t *rw) {
     return 0;
 }
 
+/* rwlock на futex: одно слово состояния вместо мьютекса и двух условных
+ * переменных. Неконкурентный захват и освобождение — одна атомарная
+ * операция без системных вызовов. Семантика как у rwlock_t: читатель
+ * ждёт только активного писателя, при освобождении сначала будится
+ * один ждущий писатель, читатели — когда писателей не осталось.
+ * Перед засыпанием поток FUTEX_SPIN раз пробует захватить блокировку.
+ */
+#define FUTEX_SPIN      100
+#define FRW_READERS     0x3FFFFFFFu     // Число читателей
+#define FRW_WRITER      0x40000000u     // Захвачена писателем
+#define FRW_RWAIT       0x80000000u     // Есть спящие читатели
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX()     __builtin_ia32_pause()
+#else
+#define CPU_RELAX()     ((void) 0)
+#endif
+
+typedef struct {
+    unsigned state;                 // Читатели, FRW_WRITER, FRW_RWAIT
+    unsigned writer_seq;            // futex писателей: меняется при каждом пробуждении
+    int waiting_writers;            // Счётчик потоков, ожидающих записи
+} futex_rwlock_t;
+
+static long futex(unsigned *addr, int op, unsigned val) {
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+int futex_rwlock_init(futex_rwlock_t *rw) {
+    rw->state = 0;
+    rw->writer_seq = 0;
+    rw->waiting_writers = 0;
+    return 0;
+}
+
+int futex_rwlock_destroy(futex_rwlock_t *rw) {
+    (void) rw;
+    return 0;
+}
+
+int futex_rwlock_rdlock(futex_rwlock_t *rw) {
+    int spin = FUTEX_SPIN;
+    unsigned s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+
+    for (;;) {
+        if (!(s & FRW_WRITER)) {
+            if (__atomic_compare_exchange_n(&rw->state, &s, s + 1, 1,
+                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return 0;
+            continue;                           // s уже перечитано
+        }
+        if (spin-- > 0) {
+            CPU_RELAX();
+            s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+            continue;
+        }
+        /* Отметиться спящим и уснуть, пока слово не изменится */
+        if (!(s & FRW_RWAIT) &&
+                !__atomic_compare_exchange_n(&rw->state, &s, s | FRW_RWAIT, 0,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            continue;
+        futex(&rw->state, FUTEX_WAIT_PRIVATE, s | FRW_RWAIT);
+        s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+    }
+}
+
+static int futex_rwlock_trywrlock(futex_rwlock_t *rw) {
+    unsigned s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+
+    while ((s & (FRW_WRITER | FRW_READERS)) == 0)
+        if (__atomic_compare_exchange_n(&rw->state, &s, s | FRW_WRITER, 1,
+                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return 1;
+    return 0;
+}
+
+int futex_rwlock_wrlock(futex_rwlock_t *rw) {
+    int spin;
+    unsigned seq;
+
+    for (spin = 0; spin < FUTEX_SPIN; spin++) {
+        if (futex_rwlock_trywrlock(rw))
+            return 0;
+        CPU_RELAX();
+    }
+
+    /* Счётчик ждущих увеличивается до чтения writer_seq и state: либо
+     * освобождающий увидит его и разбудит, либо мы увидим свободную
+     * блокировку или изменённый writer_seq */
+    __atomic_add_fetch(&rw->waiting_writers, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        seq = __atomic_load_n(&rw->writer_seq, __ATOMIC_SEQ_CST);
+        if (futex_rwlock_trywrlock(rw))
+            break;
+        futex(&rw->writer_seq, FUTEX_WAIT_PRIVATE, seq);
+    }
+    __atomic_sub_fetch(&rw->waiting_writers, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+/* Разбудить одного писателя или, если их нет, всех спящих читателей */
+static void futex_rwlock_wake(futex_rwlock_t *rw) {
+    if (__atomic_load_n(&rw->waiting_writers, __ATOMIC_SEQ_CST) > 0) {
+        __atomic_add_fetch(&rw->writer_seq, 1, __ATOMIC_SEQ_CST);
+        futex(&rw->writer_seq, FUTEX_WAKE_PRIVATE, 1);
+    } else if (__atomic_load_n(&rw->state, __ATOMIC_SEQ_CST) & FRW_RWAIT) {
+        if (__atomic_fetch_and(&rw->state, ~FRW_RWAIT, __ATOMIC_SEQ_CST) & FRW_RWAIT)
+            futex(&rw->state, FUTEX_WAKE_PRIVATE, INT_MAX);
+    }
+}
+
+int futex_rwlock_unlock(futex_rwlock_t *rw) {
+    unsigned s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+
+    if (s & FRW_WRITER) {
+        s = __atomic_and_fetch(&rw->state, ~FRW_WRITER, __ATOMIC_SEQ_CST);
+        futex_rwlock_wake(rw);
+    } else {
+        s = __atomic_sub_fetch(&rw->state, 1, __ATOMIC_SEQ_CST);
+        if ((s & FRW_READERS) == 0)
+            futex_rwlock_wake(rw);
+    }
+    return 0;
+}
+
+/* Реализация блокировки списка (ключ -l) */
+#define LOCK_COND    0    // rwlock_t выше: мьютекс и две условные переменные
+#define LOCK_FUTEX   1    // futex_rwlock_t
+#define LOCK_PTHREAD 2    // pthread_rwlock_t
+
 /* Shared variables */
 struct      list_node_s* head = NULL;  
 int         thread_count;
@@ -105,8 +244,16 @@ int         total_ops;
 double      insert_percent;
 double      search_percent;
 double      delete_percent;
+int         lock_kind = LOCK_COND;
 rwlock_t    rwlock;
+futex_rwlock_t futex_lock;
+pthread_rwlock_t pthread_lock;
 int         member_count = 0, insert_count = 0, delete_count = 0;
+struct      workload_s* work;       // Заранее сгенерированные операции потоков
+double      scan_percent = 0.0;     // Доля поисков, заменяемых на RangeScan
+int         scan_width = SCAN_WIDTH;
+int         scan_count = 0;
+long        scanned_keys = 0;
 
 /* Setup and cleanup */
 void        Usage(char* prog_name);
@@ -115,6 +262,14 @@ void        Get_input(int* inserts_in_main_p);
 /* Thread function */
 void*       Thread_work(void* rank);
 
+/* Блокировка списка выбранного вида и замер задержек */
+void        Lock_init(void);
+void        Lock_destroy(void);
+void        Lock_rd(void);
+void        Lock_wr(void);
+void        Lock_unlock(void);
+void        Lock_bench(void);
+
 /* List operations */
 int         Insert(int value);
 void        Print(void);
@@ -122,6 +277,7 @@ int         Member(int value);
 int         Delete(int value);
 void        Free_list(void);
 int         Is_empty(void);
+int         RangeScan(int lo, int hi, void (*callback)(int key, void* arg), void* arg);
 
 /*-----------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
@@ -132,8 +288,39 @@ int main(int argc, char* argv[]) {
    unsigned seed = 1;
    double start, finish;
 
-   if (argc != 2) Usage(argv[0]);
-   thread_count = strtol(argv[1],NULL,10);
+   const char* spec = "uniform";      // Распределение ключей или trace:FILE
+   const char* record_file = NULL;    // Куда записать сгенерированный трейс
+   int phases = 1, opt, bench = 0;
+   while ((opt = getopt(argc, argv, "w:p:r:s:l:b")) != -1) {
+      if (opt == 'l' && strcmp(optarg, "cond") == 0)
+         lock_kind = LOCK_COND;
+      else if (opt == 'l' && strcmp(optarg, "futex") == 0)
+         lock_kind = LOCK_FUTEX;
+      else if (opt == 'l' && strcmp(optarg, "pthread") == 0)
+         lock_kind = LOCK_PTHREAD;
+      else if (opt == 'b')
+         bench = 1;
+      else if (opt == 'w')
+         spec = optarg;
+      else if (opt == 'p')
+         phases = strtol(optarg, NULL, 10);
+      else if (opt == 'r')
+         record_file = optarg;
+      else if (opt == 's') {
+         if (sscanf(optarg, "%lf:%d", &scan_percent, &scan_width) < 1 || scan_width < 1)
+            Usage(argv[0]);
+         if (scan_width > MAX_KEY)      // key + width - 1 не переполняет int
+            scan_width = MAX_KEY;
+      } else
+         Usage(argv[0]);
+   }
+   if (optind != argc - 1) Usage(argv[0]);
+   thread_count = strtol(argv[optind],NULL,10);
+
+   if (bench) {
+      Lock_bench();
+      return 0;
+   }
 
    Get_input(&inserts_in_main);
 
@@ -148,6 +335,23 @@ int main(int argc, char* argv[]) {
    }
    printf("Inserted %ld keys in empty list\n", i);
 
+   /* Все ключи и операции генерируются до замера времени */
+   work = calloc(thread_count, sizeof(struct workload_s));
+   if (strncmp(spec, "trace:", 6) == 0) {
+      if (Workload_load_trace(work, thread_count, spec + 6) != 0) {
+         fprintf(stderr, "Can't read trace %s\n", spec + 6);
+         exit(1);
+      }
+   } else if (Workload_generate(work, thread_count, total_ops, search_percent,
+            insert_percent, scan_percent, MAX_KEY, spec, phases) != 0) {
+      fprintf(stderr, "Bad workload %s\n", spec);
+      Usage(argv[0]);
+   }
+   for (total_ops = 0, i = 0; i < thread_count; i++)
+      total_ops += work[i].count;
+   if (record_file != NULL && Workload_save_trace(work, thread_count, record_file) != 0)
+      fprintf(stderr, "Can't write trace %s\n", record_file);
+
 #  ifdef OUTPUT
    printf("Before starting threads, list = \n");
    Print();
@@ -155,7 +359,7 @@ int main(int argc, char* argv[]) {
 #  endif
 
    thread_handles = malloc(thread_count*sizeof(pthread_t));
-   rwlock_init(&rwlock);
+   Lock_init();
 
    GET_TIME(start);
    for (i = 0; i < thread_count; i++)
@@ -169,6 +373,10 @@ int main(int argc, char* argv[]) {
    printf("member ops = %d\n", member_count);
    printf("insert ops = %d\n", insert_count);
    printf("delete ops = %d\n", delete_count);
+   if (scan_count > 0)
+      printf("scan ops = %d, scanned keys = %ld (%.2f per scan)\n",
+            scan_count, scanned_keys, (double) scanned_keys / scan_count);
+   printf("Throughput = %e ops/second\n", total_ops / (finish - start));
 
 #  ifdef OUTPUT
    printf("After threads terminate, list = \n");
@@ -177,8 +385,10 @@ int main(int argc, char* argv[]) {
 #  endif
 
    Free_list();
-   rwlock_destroy(&rwlock);
+   Lock_destroy();
    free(thread_handles);
+   Workload_free(work, thread_count);
+   free(work);
 
    return 0;
 }  /* main */
@@ -186,7 +396,11 @@ int main(int argc, char* argv[]) {
 
 /*-----------------------------------------------------------------*/
 void Usage(char* prog_name) {
-   fprintf(stderr, "usage: %s <thread_count>\n", prog_name);
+   fprintf(stderr, "usage: %s [-l cond|futex|pthread] [-w workload] [-p phases] [-r trace_out]\n"
+         "          [-s scan_frac[:width]] <thread_count>\n", prog_name);
+   fprintf(stderr, "       %s -b <thread_count>   (acquire latency of the three locks)\n", prog_name);
+   fprintf(stderr, "   workload: uniform | zipf:THETA | hotspot:FRAC:PROB | seq | trace:FILE\n");
+   fprintf(stderr, "   scan_frac: share of searches replaced by RangeScan(key, key + width - 1)\n");
    exit(0);
 }  /* Usage */
 
@@ -334,41 +548,212 @@ int  Is_empty(void) {
       return 0;
 }  /* Is_empty */
 
+/*-----------------------------------------------------------------*/
+void Lock_init(void) {
+   if (lock_kind == LOCK_FUTEX)
+      futex_rwlock_init(&futex_lock);
+   else if (lock_kind == LOCK_PTHREAD)
+      pthread_rwlock_init(&pthread_lock, NULL);
+   else
+      rwlock_init(&rwlock);
+}  /* Lock_init */
+
+void Lock_destroy(void) {
+   if (lock_kind == LOCK_FUTEX)
+      futex_rwlock_destroy(&futex_lock);
+   else if (lock_kind == LOCK_PTHREAD)
+      pthread_rwlock_destroy(&pthread_lock);
+   else
+      rwlock_destroy(&rwlock);
+}  /* Lock_destroy */
+
+void Lock_rd(void) {
+   if (lock_kind == LOCK_FUTEX)
+      futex_rwlock_rdlock(&futex_lock);
+   else if (lock_kind == LOCK_PTHREAD)
+      pthread_rwlock_rdlock(&pthread_lock);
+   else
+      rwlock_rdlock(&rwlock);
+}  /* Lock_rd */
+
+void Lock_wr(void) {
+   if (lock_kind == LOCK_FUTEX)
+      futex_rwlock_wrlock(&futex_lock);
+   else if (lock_kind == LOCK_PTHREAD)
+      pthread_rwlock_wrlock(&pthread_lock);
+   else
+      rwlock_wrlock(&rwlock);
+}  /* Lock_wr */
+
+void Lock_unlock(void) {
+   if (lock_kind == LOCK_FUTEX)
+      futex_rwlock_unlock(&futex_lock);
+   else if (lock_kind == LOCK_PTHREAD)
+      pthread_rwlock_unlock(&pthread_lock);
+   else
+      rwlock_unlock(&rwlock);
+}  /* Lock_unlock */
+
+/*-----------------------------------------------------------------*/
+/* Замер задержки захвата (ключ -b): без конкуренции — пары
+ * захват/освобождение в одном потоке; с конкуренцией — thread_count
+ * потоков, доля BENCH_WRITES захватов на запись, время каждого захвата.
+ */
+#define BENCH_ITERS  1000000
+#define BENCH_WRITES 0.1
+
+static double Now_ns(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int Compare_float(const void* a, const void* b) {
+   float x = *(const float*) a, y = *(const float*) b;
+   return (x > y) - (x < y);
+}
+
+long bench_shared = 0;          // Работа в критической секции
+
+void* Bench_work(void* rank) {
+   long my_rank = (long) rank;
+   int i, n = BENCH_ITERS / thread_count;
+   unsigned seed = my_rank + 1;
+   float* lat = malloc(n * sizeof(float));
+   double t0;
+
+   for (i = 0; i < n; i++) {
+      int write = my_drand(&seed) < BENCH_WRITES;
+      t0 = Now_ns();
+      if (write) Lock_wr(); else Lock_rd();
+      lat[i] = Now_ns() - t0;
+      if (write) bench_shared++; else (void) *(volatile long*) &bench_shared;
+      Lock_unlock();
+   }
+   return lat;
+}  /* Bench_work */
+
+static void* Bench_idle(void* arg) {
+   (void) arg;
+   return NULL;
+}
+
+void Lock_bench(void) {
+   static const char* names[] = { "rwlock_t (mutex+cond)", "futex_rwlock_t", "pthread_rwlock_t" };
+   pthread_t* handles = malloc(thread_count * sizeof(pthread_t));
+   int n = BENCH_ITERS / thread_count, total = n * thread_count;
+   float* all = malloc(total * sizeof(float));
+   double start, rd_ns, wr_ns, sum;
+   long i, t;
+
+   /* Пока в процессе один поток, glibc выполняет операции мьютекса без
+    * атомарных инструкций — замер без конкуренции был бы нечестным */
+   pthread_create(&handles[0], NULL, Bench_idle, NULL);
+   pthread_join(handles[0], NULL);
+
+   printf("%-24s %10s %10s %12s %10s %10s\n", "lock", "rd+unl ns", "wr+unl ns",
+         "contended:", "mean ns", "p99 ns");
+   for (lock_kind = LOCK_COND; lock_kind <= LOCK_PTHREAD; lock_kind++) {
+      Lock_init();
+
+      start = Now_ns();
+      for (i = 0; i < BENCH_ITERS; i++) {
+         Lock_rd();
+         Lock_unlock();
+      }
+      rd_ns = (Now_ns() - start) / BENCH_ITERS;
+      start = Now_ns();
+      for (i = 0; i < BENCH_ITERS; i++) {
+         Lock_wr();
+         Lock_unlock();
+      }
+      wr_ns = (Now_ns() - start) / BENCH_ITERS;
+
+      for (t = 0; t < thread_count; t++)
+         pthread_create(&handles[t], NULL, Bench_work, (void*) t);
+      for (t = 0; t < thread_count; t++) {
+         float* lat;
+         pthread_join(handles[t], (void**) &lat);
+         memcpy(all + t * n, lat, n * sizeof(float));
+         free(lat);
+      }
+      for (i = 0, sum = 0.0; i < total; i++)
+         sum += all[i];
+      qsort(all, total, sizeof(float), Compare_float);
+
+      printf("%-24s %10.1f %10.1f %12d %10.1f %10.1f\n", names[lock_kind], rd_ns, wr_ns,
+            thread_count, sum / total, all[(long) (0.99 * (total - 1))]);
+      Lock_destroy();
+   }
+   free(all);
+   free(handles);
+}  /* Lock_bench */
+
+/*-----------------------------------------------------------------*/
+/* Вызывает callback для ключей [lo, hi] по возрастанию. Здесь весь
+ * проход идёт под блокировкой чтения rwlock (писатели ждут конца скана);
+ * версия без блокировок — в pth_ll_rwl.c. Возвращает число ключей. */
+int RangeScan(int lo, int hi, void (*callback)(int key, void* arg), void* arg) {
+   struct list_node_s* curr;
+   int n = 0;
+
+   Lock_rd();
+   curr = head;
+   while (curr != NULL && curr->data < lo)
+      curr = curr->next;
+   while (curr != NULL && curr->data <= hi) {
+      callback(curr->data, arg);
+      n++;
+      curr = curr->next;
+   }
+   Lock_unlock();
+   return n;
+}  /* RangeScan */
+
+static void Scan_count_key(int key, void* arg) {
+   (void) key;
+   (*(long*) arg)++;
+}
+
 /*-----------------------------------------------------------------*/
 void* Thread_work(void* rank) {
    long my_rank = (long) rank;
    int i, val;
-   double which_op;
-   unsigned seed = my_rank + 1;
+   struct workload_s* my_work = &work[my_rank];
    int my_member_count = 0, my_insert_count=0, my_delete_count=0;
-   int ops_per_thread = total_ops/thread_count;
+   int my_scan_count = 0;
+   long my_scanned_keys = 0;
 
-   for (i = 0; i < ops_per_thread; i++) {
-      which_op = my_drand(&seed);
-      val = my_rand(&seed) % MAX_KEY;
-      if (which_op < search_percent) {
-         rwlock_rdlock(&rwlock);
+   for (i = 0; i < my_work->count; i++) {
+      val = my_work->keys[i];
+      if (my_work->ops[i] == OP_MEMBER) {
+         Lock_rd();
          Member(val);
-         rwlock_unlock(&rwlock);
+         Lock_unlock();
          my_member_count++;
-      } else if (which_op < search_percent + insert_percent) {
-         rwlock_wrlock(&rwlock);
+      } else if (my_work->ops[i] == OP_SCAN) {
+         RangeScan(val, val + (scan_width - 1), Scan_count_key, &my_scanned_keys);
+         my_scan_count++;
+      } else if (my_work->ops[i] == OP_INSERT) {
+         Lock_wr();
          Insert(val);
-         rwlock_unlock(&rwlock);
+         Lock_unlock();
          my_insert_count++;
       } else { /* delete */
-         rwlock_wrlock(&rwlock);
+         Lock_wr();
          Delete(val);
-         rwlock_unlock(&rwlock);
+         Lock_unlock();
          my_delete_count++;
       }
    }  /* for */
 
-   rwlock_wrlock(&rwlock);
+   Lock_wr();
    member_count += my_member_count;
    insert_count += my_insert_count;
    delete_count += my_delete_count;
-   rwlock_unlock(&rwlock);
+   scan_count += my_scan_count;
+   scanned_keys += my_scanned_keys;
+   Lock_unlock();
 
    return NULL;
 }  /* Thread_work */
@@ -0,0 +1,214 @@
+/* Генератор нагрузки для сервера pth_ll_rwl -S: conns соединений (по
+ * потоку на соединение), в каждом requests запросов из workload.c,
+ * до depth запросов в полёте (конвейер). Задержка запроса — от записи
+ * пачки в сокет до прихода его ответа.
+ *
+ * Сборка: gcc -O2 -Wall -pthread ll_client.c my_rand.c workload.c -lm -o ll_client
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "workload.h"
+#include "ll_proto.h"
+
+/* Ключи как у pth_ll_rwl */
+const int MAX_KEY = 100000000;
+
+#define DEPTH_MAX 4096
+
+/* Shared variables */
+const char* socket_path;
+int         conns = 4;
+int         requests = 100000;      // На соединение
+int         depth = 32;
+struct      workload_s* work;
+float**     latency;                // Задержки запросов соединения, мкс
+long        hits = 0;
+pthread_mutex_t hits_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void        Usage(char* prog_name);
+void*       Client_work(void* rank);
+
+/*-----------------------------------------------------------------*/
+static double Now_us(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int Compare_float(const void* a, const void* b) {
+   float x = *(const float*) a, y = *(const float*) b;
+   return (x > y) - (x < y);
+}
+
+static int Connect(void) {
+   struct sockaddr_un addr;
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+   if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+      perror(socket_path);
+      exit(1);
+   }
+   return fd;
+}
+
+static void Write_all(int fd, const void* buf, size_t len) {
+   const char* p = buf;
+   while (len > 0) {
+      ssize_t w = write(fd, p, len);
+      if (w <= 0) {
+         perror("write");
+         exit(1);
+      }
+      p += w;
+      len -= w;
+   }
+}
+
+/*-----------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   double search_percent = 0.8, insert_percent = 0.1, start, finish;
+   const char* spec = "uniform";
+   int opt, shutdown = 0, total;
+   long i, t;
+   pthread_t* handles;
+
+   while ((opt = getopt(argc, argv, "c:n:d:f:w:q")) != -1) {
+      if (opt == 'c')
+         conns = strtol(optarg, NULL, 10);
+      else if (opt == 'n')
+         requests = strtol(optarg, NULL, 10);
+      else if (opt == 'd')
+         depth = strtol(optarg, NULL, 10);
+      else if (opt == 'f') {
+         if (sscanf(optarg, "%lf:%lf", &search_percent, &insert_percent) != 2)
+            Usage(argv[0]);
+      } else if (opt == 'w')
+         spec = optarg;
+      else if (opt == 'q')
+         shutdown = 1;
+      else
+         Usage(argv[0]);
+   }
+   if (optind != argc - 1 || conns < 1 || requests < 1 || depth < 1 || depth > DEPTH_MAX)
+      Usage(argv[0]);
+   socket_path = argv[optind];
+
+   work = calloc(conns, sizeof(struct workload_s));
+   if (Workload_generate(work, conns, conns * requests, search_percent, insert_percent,
+            0.0, MAX_KEY, spec, 1) != 0) {
+      fprintf(stderr, "Bad workload %s\n", spec);
+      Usage(argv[0]);
+   }
+   latency = malloc(conns * sizeof(float*));
+   handles = malloc(conns * sizeof(pthread_t));
+
+   start = Now_us();
+   for (t = 0; t < conns; t++)
+      pthread_create(&handles[t], NULL, Client_work, (void*) t);
+   for (t = 0; t < conns; t++)
+      pthread_join(handles[t], NULL);
+   finish = Now_us();
+
+   /* Сводка по всем соединениям */
+   total = conns * requests;
+   float* all = malloc(total * sizeof(float));
+   double sum = 0.0;
+   for (t = 0; t < conns; t++) {
+      memcpy(all + t * requests, latency[t], requests * sizeof(float));
+      free(latency[t]);
+   }
+   for (i = 0; i < total; i++)
+      sum += all[i];
+   qsort(all, total, sizeof(float), Compare_float);
+   printf("Requests = %d over %d connections, depth %d\n", total, conns, depth);
+   printf("Elapsed time = %e seconds\n", (finish - start) / 1e6);
+   printf("Throughput = %e requests/second\n", total / ((finish - start) / 1e6));
+   printf("Latency us: mean %.1f  p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+         sum / total, all[total / 2], all[(long) (0.99 * (total - 1))],
+         all[(long) (0.999 * (total - 1))], all[total - 1]);
+   printf("Hits = %ld\n", hits);
+
+   if (shutdown) {
+      struct ll_request_s req;
+      int fd = Connect();
+      memset(&req, 0, sizeof(req));
+      req.op = LL_SHUTDOWN;
+      Write_all(fd, &req, sizeof(req));
+      close(fd);
+   }
+
+   free(all);
+   free(latency);
+   free(handles);
+   Workload_free(work, conns);
+   free(work);
+   return 0;
+}  /* main */
+
+/*-----------------------------------------------------------------*/
+void Usage(char* prog_name) {
+   fprintf(stderr, "usage: %s [-c conns] [-n requests_per_conn] [-d depth] [-f search:insert]\n"
+         "          [-w workload] [-q] <socket>\n", prog_name);
+   fprintf(stderr, "   workload: uniform | zipf:THETA | hotspot:FRAC:PROB | seq\n");
+   fprintf(stderr, "   -q: stop the server after the run\n");
+   exit(0);
+}  /* Usage */
+
+/*-----------------------------------------------------------------*/
+/* Держит до depth запросов в полёте: дописывает окно одной записью,
+ * потом читает пришедшие ответы */
+void* Client_work(void* rank) {
+   long my_rank = (long) rank;
+   struct workload_s* my_work = &work[my_rank];
+   struct ll_request_s reqs[DEPTH_MAX];
+   unsigned char resp[DEPTH_MAX];
+   double* sent_at = malloc(requests * sizeof(double));
+   float* lat = malloc(requests * sizeof(float));
+   int fd = Connect(), sent = 0, done = 0, k, j;
+   long my_hits = 0;
+   ssize_t r;
+   double now;
+
+   memset(reqs, 0, sizeof(reqs));
+   while (done < my_work->count) {
+      for (k = 0; sent + k < my_work->count && sent + k - done < depth; k++) {
+         reqs[k].op = my_work->ops[sent + k];
+         reqs[k].key = my_work->keys[sent + k];
+      }
+      if (k > 0) {
+         now = Now_us();
+         for (j = 0; j < k; j++)
+            sent_at[sent + j] = now;
+         Write_all(fd, reqs, k * sizeof(struct ll_request_s));
+         sent += k;
+      }
+
+      r = read(fd, resp, sent - done);
+      if (r <= 0) {
+         fprintf(stderr, "Connection %ld closed by server\n", my_rank);
+         exit(1);
+      }
+      now = Now_us();
+      for (j = 0; j < r; j++, done++) {
+         lat[done] = now - sent_at[done];
+         my_hits += resp[j];
+      }
+   }
+
+   close(fd);
+   free(sent_at);
+   latency[my_rank] = lat;
+   pthread_mutex_lock(&hits_mutex);
+   hits += my_hits;
+   pthread_mutex_unlock(&hits_mutex);
+   return NULL;
+}  /* Client_work */
@@ -0,0 +1,20 @@
+#ifndef _LL_PROTO_H_
+#define _LL_PROTO_H_
+
+/* Протокол key-service (pth_ll_rwl -S и ll_client) поверх Unix-сокета.
+ * Запрос — 8 байт ll_request_s, ответ — 1 байт: результат Member,
+ * Insert или Delete (0 или 1). Ответы идут в порядке запросов своего
+ * соединения, поэтому клиент может слать запросы, не дожидаясь ответов.
+ * Числа в порядке байт платформы (оба конца на одной машине).
+ */
+#include "workload.h"
+
+#define LL_SHUTDOWN 255     // Остановить сервер (ответа нет)
+
+struct ll_request_s {
+   unsigned char op;        // OP_MEMBER, OP_INSERT, OP_DELETE или LL_SHUTDOWN
+   unsigned char pad[3];
+   int           key;
+};
+
+#endif
@@ -59,3 +59,21 @@ double my_drand(unsigned* seed_p) {
    double y = x/MR_DIVISOR;
    return y;
 }
+
+/* Function:      my_rand_jump
+ * In/out arg:    seed_p
+ * In arg:        k
+ * Notes:         Advances the state by k calls of my_rand in O(log k):
+ *                the generator is multiplicative, so the new state is
+ *                seed * MULTIPLIER^k mod MODULUS.
+ */
+void my_rand_jump(unsigned* seed_p, unsigned long k) {
+   unsigned long long result = *seed_p, base = MR_MULTIPLIER;
+
+   while (k > 0) {
+      if (k & 1) result = result * base % MR_MODULUS;
+      base = base * base % MR_MODULUS;
+      k >>= 1;
+   }
+   *seed_p = result;
+}
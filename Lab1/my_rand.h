@@ -3,5 +3,6 @@
 
 unsigned my_rand(unsigned* a_p);
 double my_drand(unsigned* a_p);
+void my_rand_jump(unsigned* a_p, unsigned long k);
 
 #endif
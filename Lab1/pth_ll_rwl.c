@@ -1,16 +1,39 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <errno.h>
 #include "my_rand.h"
 #include "timer.h"
+#include "workload.h"
+#include "ll_proto.h"
 
 /* Random ints are less than MAX_KEY */
 const int MAX_KEY = 100000000;
 
 
+/* Режимы синхронизации в Thread_work (ключ -m) */
+#define MODE_RWLOCK 0   // Общий pthread_rwlock_t на весь список
+#define MODE_LAZY   1   // Ленивый список: Member без блокировок, блокировки узлов
+#define MODE_FC     2   // Flat combining: Insert/Delete применяет пачкой один поток
+
+#define LOAD(p)       __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)   __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
 /* Struct for list nodes */
 struct list_node_s {
    int    data;
+   int    marked;               // Узел логически удалён (ленивый список)
+   pthread_spinlock_t lock;     // Блокировка узла (ленивый список)
    struct list_node_s* next;
 };
 
@@ -24,6 +47,65 @@ double      delete_percent;
 pthread_rwlock_t    rwlock;
 pthread_mutex_t     count_mutex;
 int         member_count = 0, insert_count = 0, delete_count = 0;
+int         mode = MODE_RWLOCK;
+struct      workload_s* work;       // Заранее сгенерированные операции потоков
+pthread_spinlock_t head_lock;   // Блокировка указателя head (вместо узла-предшественника)
+long        retry_count = 0;    // Повторы после неудачной проверки (ленивый список)
+struct      list_node_s** retired = NULL;  // Удалённые узлы, освобождаются после потоков
+long        retired_count = 0;
+struct      list_node_s* bulk_nodes = NULL;  // Блок узлов Bulk_preload
+long        bulk_count = 0;
+int         hash_enabled = 0;   // Member идёт в хэш-индекс (ключ -H)
+int*        hash_slots = NULL;
+#define BATCH_MAX 64
+int         member_batch = 1;   // Подряд идущие Member группами до G (ключ -g)
+
+/* Сервер (ключ -S) */
+#define SERVER_BUF     65536        // Байт запросов, читаемых за раз
+#define SERVER_EVENTS  64
+#define SERVER_HASH_INSERTS (1 << 21)   // Запас хэш-индекса под вставки клиентов
+unsigned long hash_mask = 0;
+int         hash_shift = 64;    // 64 - log2(ёмкости): Hash_slot берёт старшие биты
+long        hash_used = 0;      // Ячеек, занятых из HASH_EMPTY
+
+/* RangeScan: оптимистичный проход без блокировок с проверкой версий.
+ * Пространство ключей разбито на SCAN_STRIPES полос; писатель, меняющий
+ * ключ k, увеличивает begin полосы k до изменения и end — после. Скан
+ * действителен, если в его полосах не было незавершённых записей в
+ * начале и не началось новых до конца прохода. Записи вне [lo, hi]
+ * скан не сбивают.
+ */
+#define SCAN_STRIPES 1024
+#define SCAN_WIDTH   1000000   // Ширина диапазона по умолчанию (ключ -s)
+#define SCAN_RETRIES 8         // Потом скан берёт rdlock (кроме lazy)
+#define STRIPE(k)    ((k) / (MAX_KEY / SCAN_STRIPES + 1))
+struct scan_stripe_s {
+   long   begin;
+   long   end;
+   char   pad[64 - 2 * sizeof(long)];
+};
+struct      scan_stripe_s scan_stripes[SCAN_STRIPES] __attribute__((aligned(64)));
+int         scans_enabled = 0;  // Писатели отмечают записи и не освобождают узлы
+double      scan_percent = 0.0;
+int         scan_width = SCAN_WIDTH;
+int         scan_count = 0;
+long        scanned_keys = 0, scan_retries = 0, scan_fallbacks = 0;
+
+/* Flat combining: слот публикации запроса на поток (своя кэш-линия) */
+#define FC_INSERT 1
+#define FC_DELETE 2
+struct fc_slot_s {
+   int    op;          // FC_INSERT или FC_DELETE
+   int    value;
+   int    result;      // Результат Insert/Delete
+   int    pending;     // 1 — запрос опубликован и ещё не выполнен
+   char   pad[64 - 4 * sizeof(int)];
+};
+struct      fc_slot_s* fc_slots = NULL;
+pthread_mutex_t fc_lock;        // Кто держит — тот комбинирует
+long        fc_passes = 0;      // Проходов комбинирования
+long        fc_requests = 0;    // Выполнено запросов в них
+int         fc_max_batch = 0;
 
 /* Setup and cleanup */
 void        Usage(char* prog_name);
@@ -31,6 +113,9 @@ void        Get_input(int* inserts_in_main_p);
 
 /* Thread function */
 void*       Thread_work(void* rank);
+int         List_apply(long my_rank, int op, int val, long* retries_p);
+int         Serve(const char* path);
+void        Member_group(const int* values, int* found, int count);
 
 /* List operations */
 int         Insert(int value);
@@ -39,6 +124,36 @@ int         Member(int value);
 int         Delete(int value);
 void        Free_list(void);
 int         Is_empty(void);
+long        Bulk_preload(int n, unsigned seed, int threads, int scatter);
+void        Free_node(struct list_node_s* node);
+int         Save_snapshot(const char* filename);
+long        Load_snapshot(const char* filename, int scatter);
+
+/* Хэш-индекс */
+long        Hash_init(long max_keys);
+int         Hash_member(int value);
+void        Hash_insert(int value);
+void        Hash_delete(int value);
+void        Hash_full(void);
+
+/* Ленивый список */
+int         Lazy_member(int value);
+int         Lazy_insert(int value, long* retries_p);
+int         Lazy_delete(int value, long* retries_p);
+void        Retire(struct list_node_s* node);
+void        Retire_merge(void);
+void        Dispose(struct list_node_s* node);
+
+/* Группа поисков за один проход */
+int         Member_batch(const int* values, int* found, int count);
+
+/* Сканирование диапазона */
+int         RangeScan(int lo, int hi, void (*callback)(int key, void* arg), void* arg,
+                  long* retries_p, long* fallbacks_p);
+
+/* Flat combining */
+int         Fc_apply(long my_rank, int op, int value);
+void        Fc_combine(void);
 
 /*-----------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
@@ -46,24 +161,121 @@ int main(int argc, char* argv[]) {
    int key, success, attempts;
    pthread_t* thread_handles;
    int inserts_in_main;
+   long list_keys;
    unsigned seed = 1;
    double start, finish;
 
-   if (argc != 2) Usage(argv[0]);
-   thread_count = strtol(argv[1],NULL,10);
+   int opt;
+   const char* spec = "uniform";      // Распределение ключей или trace:FILE
+   const char* record_file = NULL;    // Куда записать сгенерированный трейс
+   int phases = 1;
+   int bulk = 1;                      // 0 — загрузка по одному Insert (ключ -i)
+   int scatter = 0;                   // Перемешать узлы при загрузке (ключ -X)
+   const char* load_file = NULL;      // Начальное множество из снимка (ключ -L)
+   const char* dump_file = NULL;      // Сохранить начальное множество (ключ -D)
+   const char* server_path = NULL;    // Режим сервера на Unix-сокете (ключ -S)
+   while ((opt = getopt(argc, argv, "m:w:p:r:s:iHXg:L:D:S:")) != -1) {
+      if (opt == 'm' && strcmp(optarg, "rwlock") == 0)
+         mode = MODE_RWLOCK;
+      else if (opt == 'm' && strcmp(optarg, "lazy") == 0)
+         mode = MODE_LAZY;
+      else if (opt == 'm' && strcmp(optarg, "fc") == 0)
+         mode = MODE_FC;
+      else if (opt == 'w')
+         spec = optarg;
+      else if (opt == 'p')
+         phases = strtol(optarg, NULL, 10);
+      else if (opt == 'r')
+         record_file = optarg;
+      else if (opt == 's') {
+         if (sscanf(optarg, "%lf:%d", &scan_percent, &scan_width) < 1 || scan_width < 1)
+            Usage(argv[0]);
+         if (scan_width > MAX_KEY)      // key + width - 1 не переполняет int
+            scan_width = MAX_KEY;
+      } else if (opt == 'i')
+         bulk = 0;
+      else if (opt == 'H')
+         hash_enabled = 1;
+      else if (opt == 'X')
+         scatter = 1;
+      else if (opt == 'g') {
+         member_batch = strtol(optarg, NULL, 10);
+         if (member_batch < 1 || member_batch > BATCH_MAX) Usage(argv[0]);
+      } else if (opt == 'L')
+         load_file = optarg;
+      else if (opt == 'D')
+         dump_file = optarg;
+      else if (opt == 'S')
+         server_path = optarg;
+      else
+         Usage(argv[0]);
+   }
+   if (optind != argc - 1) Usage(argv[0]);
+   thread_count = strtol(argv[optind],NULL,10);
 
    Get_input(&inserts_in_main);
 
    /* Try to insert inserts_in_main keys, but give up after */
    /* 2*inserts_in_main attempts.                           */
-   i = attempts = 0;
-   while ( i < inserts_in_main && attempts < 2*inserts_in_main ) {
-      key = my_rand(&seed) % MAX_KEY;
-      success = Insert(key);
-      attempts++;
-      if (success) i++;
+   GET_TIME(start);
+   if (load_file != NULL) {
+      i = Load_snapshot(load_file, scatter);
+      if (i < 0) {
+         fprintf(stderr, "Can't load snapshot %s\n", load_file);
+         exit(1);
+      }
+   } else if (bulk) {
+      i = Bulk_preload(inserts_in_main, seed, thread_count, scatter);
+   } else {
+      i = attempts = 0;
+      while ( i < inserts_in_main && attempts < 2*inserts_in_main ) {
+         key = my_rand(&seed) % MAX_KEY;
+         success = Insert(key);
+         attempts++;
+         if (success) i++;
+      }
    }
+   GET_TIME(finish);
    printf("Inserted %ld keys in empty list\n", i);
+   printf("Preload time = %e seconds (%s%s)\n", finish - start,
+         load_file != NULL ? "snapshot" : bulk ? "bulk" : "one Insert per key",
+         scatter && (load_file != NULL || bulk) ? ", scattered" : "");
+   if (dump_file != NULL && Save_snapshot(dump_file) != 0)
+      fprintf(stderr, "Can't write snapshot %s\n", dump_file);
+   list_keys = i;
+
+   /* Все ключи и операции генерируются до замера времени */
+   work = calloc(thread_count, sizeof(struct workload_s));
+   if (strncmp(spec, "trace:", 6) == 0) {
+      if (Workload_load_trace(work, thread_count, spec + 6) != 0) {
+         fprintf(stderr, "Can't read trace %s\n", spec + 6);
+         exit(1);
+      }
+   } else if (Workload_generate(work, thread_count, total_ops, search_percent,
+            insert_percent, scan_percent, MAX_KEY, spec, phases) != 0) {
+      fprintf(stderr, "Bad workload %s\n", spec);
+      Usage(argv[0]);
+   }
+   long max_keys = list_keys;         // Оценка сверху для хэш-индекса
+   for (total_ops = 0, i = 0; i < thread_count; i++) {
+      int j;
+      total_ops += work[i].count;
+      for (j = 0; j < work[i].count; j++) {
+         scans_enabled |= work[i].ops[j] == OP_SCAN;
+         max_keys += work[i].ops[j] == OP_INSERT;
+      }
+   }
+   if (server_path != NULL)
+      max_keys += SERVER_HASH_INSERTS;
+   if (hash_enabled) {
+      long keys = Hash_init(max_keys);
+      printf("Hash index: %lu slots, %.2f MB, %.1f bytes per key (list node %zu bytes)\n",
+            hash_mask + 1, (hash_mask + 1) * sizeof(int) / 1048576.0,
+            keys ? (double) (hash_mask + 1) * sizeof(int) / keys : 0.0,
+            sizeof(struct list_node_s));
+   }
+   if (record_file != NULL && Workload_save_trace(work, thread_count, record_file) != 0)
+      fprintf(stderr, "Can't write trace %s\n", record_file);
 
 #  ifdef OUTPUT
    printf("Before starting threads, list = \n");
@@ -74,19 +286,44 @@ int main(int argc, char* argv[]) {
    thread_handles = malloc(thread_count*sizeof(pthread_t));
    pthread_mutex_init(&count_mutex, NULL);
    pthread_rwlock_init(&rwlock, NULL);
+   pthread_spin_init(&head_lock, PTHREAD_PROCESS_PRIVATE);
+   pthread_mutex_init(&fc_lock, NULL);
+   if (posix_memalign((void**) &fc_slots, 64, thread_count*sizeof(struct fc_slot_s)) != 0) {
+      fprintf(stderr, "Can't allocate publication slots\n");
+      exit(1);
+   }
+   memset(fc_slots, 0, thread_count*sizeof(struct fc_slot_s));
 
    GET_TIME(start);
-   for (i = 0; i < thread_count; i++)
-      pthread_create(&thread_handles[i], NULL, Thread_work, (void*) i);
+   if (server_path != NULL) {
+      /* Операции приходят от клиентов, сгенерированные не используются */
+      if (Serve(server_path) != 0) exit(1);
+      total_ops = member_count + insert_count + delete_count;
+   } else {
+      for (i = 0; i < thread_count; i++)
+         pthread_create(&thread_handles[i], NULL, Thread_work, (void*) i);
 
-   for (i = 0; i < thread_count; i++)
-      pthread_join(thread_handles[i], NULL);
+      for (i = 0; i < thread_count; i++)
+         pthread_join(thread_handles[i], NULL);
+   }
    GET_TIME(finish);
    printf("Elapsed time = %e seconds\n", finish - start);
    printf("Total ops = %d\n", total_ops);
    printf("member ops = %d\n", member_count);
    printf("insert ops = %d\n", insert_count);
    printf("delete ops = %d\n", delete_count);
+   if (scans_enabled) {
+      printf("scan ops = %d\n", scan_count);
+      printf("Scanned keys = %ld (%.2f per scan), scan retries = %ld, read lock fallbacks = %ld\n",
+            scanned_keys, scan_count ? (double) scanned_keys / scan_count : 0.0,
+            scan_retries, scan_fallbacks);
+   }
+   printf("Throughput = %e ops/second\n", total_ops / (finish - start));
+   if (mode == MODE_LAZY)
+      printf("Validation retries = %ld\n", retry_count);
+   if (mode == MODE_FC && fc_passes > 0)
+      printf("Combining passes = %ld, mean batch = %.2f, max batch = %d\n",
+            fc_passes, (double) fc_requests / fc_passes, fc_max_batch);
 
 #  ifdef OUTPUT
    printf("After threads terminate, list = \n");
@@ -95,9 +332,19 @@ int main(int argc, char* argv[]) {
 #  endif
 
    Free_list();
+   for (i = 0; i < retired_count; i++)
+      Free_node(retired[i]);
+   free(retired);
+   free(bulk_nodes);
+   free(hash_slots);
+   pthread_spin_destroy(&head_lock);
+   pthread_mutex_destroy(&fc_lock);
+   free(fc_slots);
    pthread_rwlock_destroy(&rwlock);
    pthread_mutex_destroy(&count_mutex);
    free(thread_handles);
+   Workload_free(work, thread_count);
+   free(work);
 
    return 0;
 }  /* main */
@@ -105,7 +352,19 @@ int main(int argc, char* argv[]) {
 
 /*-----------------------------------------------------------------*/
 void Usage(char* prog_name) {
-   fprintf(stderr, "usage: %s <thread_count>\n", prog_name);
+   fprintf(stderr, "usage: %s [-m rwlock|lazy|fc] [-w workload] [-p phases] [-r trace_out]\n"
+         "          [-s scan_frac[:width]] [-i] [-X] [-H] [-g G] [-L snapshot] [-D snapshot]\n"
+         "          [-S socket] <thread_count>\n", prog_name);
+   fprintf(stderr, "   workload: uniform | zipf:THETA | hotspot:FRAC:PROB | seq | trace:FILE\n");
+   fprintf(stderr, "   scan_frac: share of searches replaced by RangeScan(key, key + width - 1)\n");
+   fprintf(stderr, "   -i: preload with one Insert per key instead of the parallel bulk build\n");
+   fprintf(stderr, "   -X: scatter preloaded nodes across their block (pointer-chasing layout)\n");
+   fprintf(stderr, "   -H: answer Member from a concurrent hash index kept in sync with the list\n");
+   fprintf(stderr, "   -g: answer up to G consecutive Member ops in one walk (1..%d)\n", BATCH_MAX);
+   fprintf(stderr, "   -L: start from a snapshot file instead of the preload; -D: write the initial set\n");
+   fprintf(stderr, "   -S: serve Member/Insert/Delete on a Unix socket with thread_count workers (see ll_client)\n");
+   fprintf(stderr, "       with -m lazy or scans deleted nodes are freed only at exit, so the server\n"
+         "       is for benchmark runs; the -H index turns off once 3/4 full\n");
    exit(0);
 }  /* Usage */
 
@@ -140,11 +399,13 @@ int Insert(int value) {
    if (curr == NULL || curr->data > value) {
       temp = malloc(sizeof(struct list_node_s));
       temp->data = value;
+      temp->marked = 0;
+      pthread_spin_init(&temp->lock, PTHREAD_PROCESS_PRIVATE);
       temp->next = curr;
       if (pred == NULL)
-         head = temp;
+         STORE(head, temp);
       else
-         pred->next = temp;
+         STORE(pred->next, temp);
    } else { /* value in list */
       rv = 0;
    }
@@ -204,17 +465,17 @@ int Delete(int value) {
    
    if (curr != NULL && curr->data == value) {
       if (pred == NULL) { /* first element in list */
-         head = curr->next;
+         STORE(head, curr->next);
 #        ifdef DEBUG
          printf("Freeing %d\n", value);
 #        endif
-         free(curr);
+         Dispose(curr);
       } else { 
-         pred->next = curr->next;
+         STORE(pred->next, curr->next);
 #        ifdef DEBUG
          printf("Freeing %d\n", value);
 #        endif
-         free(curr);
+         Dispose(curr);
       }
    } else { /* Not in list */
       rv = 0;
@@ -235,14 +496,14 @@ void Free_list(void) {
 #     ifdef DEBUG
       printf("Freeing %d\n", current->data);
 #     endif
-      free(current);
+      Free_node(current);
       current = following;
       following = current->next;
    }
 #  ifdef DEBUG
    printf("Freeing %d\n", current->data);
 #  endif
-   free(current);
+   Free_node(current);
 }  /* Free_list */
 
 /*-----------------------------------------------------------------*/
@@ -253,33 +514,1084 @@ int  Is_empty(void) {
       return 0;
 }  /* Is_empty */
 
+/*-----------------------------------------------------------------*/
+/* Быстрая начальная загрузка: те же попытки, что у цикла с Insert
+ * (первые 2n значений my_rand с seed, остановка на n-м новом ключе),
+ * но за O(n log n):
+ *    1. потоки генерируют свои куски попыток (my_rand_jump);
+ *    2. сортируют куски пар (ключ, номер попытки), затем сливают их
+ *       попарно за log T раундов;
+ *    3. первая пара каждой группы ключа — его первое появление; по
+ *       номерам попыток находится, где цикл с Insert остановился бы;
+ *    4. выбранные ключи уже по возрастанию — узлы связываются подряд
+ *       в одном блоке памяти (bulk_nodes).
+ * Узлы из блока не освобождаются по одному, см. Free_node.
+ * С -X узлы лежат в блоке в перемешанном порядке: проход по списку —
+ * случайные обращения к памяти, как после вставок по одному.
+ */
+struct preload_pair_s {
+   int    key;
+   int    attempt;
+};
+
+struct preload_s {
+   int    thread_count;
+   long   attempts;                  // 2 * n
+   int    want;                      // n
+   unsigned seed;
+   struct preload_pair_s* pairs;
+   struct preload_pair_s* tmp;
+   char*  is_first;                  // По номеру попытки
+   long   cut;                       // Сколько попыток сделал бы цикл с Insert
+   long*  chunk_count;               // Выбранных ключей в куске потока
+   int    scatter;                   // Раскидать узлы по блоку (ключ -X)
+   unsigned long stride;             // k-й по порядку узел лежит в nodes[k * stride % total]
+   struct list_node_s* nodes;
+   pthread_barrier_t barrier;
+};
+
+struct preload_arg_s {
+   long   rank;
+   struct preload_s* p;
+};
+
+static int Preload_compare(const void* a, const void* b) {
+   const struct preload_pair_s* x = a;
+   const struct preload_pair_s* y = b;
+   if (x->key != y->key) return x->key < y->key ? -1 : 1;
+   return x->attempt - y->attempt;
+}
+
+static long Chunk_start(struct preload_s* p, long r) {
+   if (r > p->thread_count) r = p->thread_count;
+   return p->attempts * r / p->thread_count;
+}
+
+static void Merge_runs(struct preload_pair_s* src, struct preload_pair_s* dst,
+      long lo, long mid, long hi) {
+   long i = lo, j = mid, k = lo;
+
+   while (i < mid && j < hi)
+      dst[k++] = Preload_compare(&src[i], &src[j]) <= 0 ? src[i++] : src[j++];
+   while (i < mid) dst[k++] = src[i++];
+   while (j < hi) dst[k++] = src[j++];
+}
+
+static unsigned long Gcd(unsigned long a, unsigned long b) {
+   while (b != 0) {
+      unsigned long t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+}
+
+static int Preload_selected(struct preload_s* p, long pos) {
+   return (pos == 0 || p->pairs[pos - 1].key != p->pairs[pos].key)
+         && p->pairs[pos].attempt < p->cut;
+}
+
+static void* Preload_work(void* arg) {
+   struct preload_arg_s* a = arg;
+   struct preload_s* p = a->p;
+   long rank = a->rank, lo = Chunk_start(p, rank), hi = Chunk_start(p, rank + 1);
+   struct preload_pair_s *src = p->pairs, *dst = p->tmp, *swap;
+   unsigned seed = p->seed;
+   long i, w, count;
+
+   /* 1. Попытки lo..hi-1 */
+   my_rand_jump(&seed, lo);
+   for (i = lo; i < hi; i++) {
+      src[i].key = my_rand(&seed) % MAX_KEY;
+      src[i].attempt = i;
+   }
+
+   /* 2. Сортировка куска и попарное слияние */
+   qsort(src + lo, hi - lo, sizeof(struct preload_pair_s), Preload_compare);
+   for (w = 1; w < p->thread_count; w *= 2) {
+      pthread_barrier_wait(&p->barrier);
+      if (rank % (2 * w) == 0)
+         Merge_runs(src, dst, Chunk_start(p, rank), Chunk_start(p, rank + w),
+               Chunk_start(p, rank + 2 * w));
+      swap = src; src = dst; dst = swap;
+   }
+   pthread_barrier_wait(&p->barrier);
+   if (rank == 0) p->pairs = src;    // Итоговый порядок
+   pthread_barrier_wait(&p->barrier);
+
+   /* 3. Первые появления ключей; rank 0 ищет точку остановки */
+   for (i = lo; i < hi; i++)
+      if (i == 0 || p->pairs[i - 1].key != p->pairs[i].key)
+         p->is_first[p->pairs[i].attempt] = 1;
+   pthread_barrier_wait(&p->barrier);
+   if (rank == 0) {
+      for (i = 0, count = 0; i < p->attempts && count < p->want; i++)
+         count += p->is_first[i];
+      p->cut = i;
+   }
+   pthread_barrier_wait(&p->barrier);
+
+   /* 4. Подсчёт, размещение и связывание узлов */
+   for (i = lo, count = 0; i < hi; i++)
+      count += Preload_selected(p, i);
+   p->chunk_count[rank] = count;
+   pthread_barrier_wait(&p->barrier);
+   if (rank == 0) {
+      long total = 0, c;
+      for (i = 0; i < p->thread_count; i++) {
+         c = p->chunk_count[i];
+         p->chunk_count[i] = total;  // Теперь — смещение куска
+         total += c;
+      }
+      p->nodes = malloc((total + 1) * sizeof(struct list_node_s));
+      bulk_count = total;
+      p->stride = 1;
+      if (p->scatter && total > 1) {
+         /* Шаг, взаимно простой с total, ~ total / золотое сечение */
+         p->stride = (unsigned long) (total * 0.6180339887) | 1;
+         while (Gcd(p->stride, total) != 1) p->stride += 2;
+      }
+   }
+   pthread_barrier_wait(&p->barrier);
+   for (i = lo, count = p->chunk_count[rank]; i < hi; i++)
+      if (Preload_selected(p, i)) {
+         struct list_node_s* node = &p->nodes[count * p->stride % bulk_count];
+         count++;
+         node->data = p->pairs[i].key;
+         node->marked = 0;
+         pthread_spin_init(&node->lock, PTHREAD_PROCESS_PRIVATE);
+         node->next = count < bulk_count ? &p->nodes[count * p->stride % bulk_count] : NULL;
+      }
+
+   return NULL;
+}  /* Preload_work */
+
+/* Возвращает число вставленных ключей; список должен быть пуст */
+long Bulk_preload(int n, unsigned seed, int threads, int scatter) {
+   struct preload_s p;
+   struct preload_pair_s* bufs[2];
+   struct preload_arg_s* args;
+   pthread_t* handles;
+   long i;
+
+   if (n <= 0) return 0;
+   p.thread_count = threads;
+   p.attempts = 2L * n;
+   p.want = n;
+   p.seed = seed;
+   p.scatter = scatter;
+   p.pairs = malloc(p.attempts * sizeof(struct preload_pair_s));
+   p.tmp = malloc(p.attempts * sizeof(struct preload_pair_s));
+   p.is_first = calloc(p.attempts, 1);
+   p.chunk_count = malloc(threads * sizeof(long));
+   bufs[0] = p.pairs;
+   bufs[1] = p.tmp;
+   pthread_barrier_init(&p.barrier, NULL, threads);
+
+   args = malloc(threads * sizeof(struct preload_arg_s));
+   handles = malloc(threads * sizeof(pthread_t));
+   for (i = 0; i < threads; i++) {
+      args[i].rank = i;
+      args[i].p = &p;
+      pthread_create(&handles[i], NULL, Preload_work, &args[i]);
+   }
+   for (i = 0; i < threads; i++)
+      pthread_join(handles[i], NULL);
+
+   bulk_nodes = p.nodes;
+   head = bulk_count > 0 ? bulk_nodes : NULL;
+
+   pthread_barrier_destroy(&p.barrier);
+   free(bufs[0]);
+   free(bufs[1]);
+   free(p.is_first);
+   free(p.chunk_count);
+   free(args);
+   free(handles);
+   return bulk_count;
+}  /* Bulk_preload */
+
+/*-----------------------------------------------------------------*/
+/* Снимок множества (ключи -D и -L): заголовок и ключи по возрастанию,
+ * без указателей, так что файл не зависит от адресов. Load_snapshot
+ * отображает файл через mmap и связывает узлы одним проходом по
+ * массиву в одном блоке (как Bulk_preload) — без генерации и
+ * сортировки. Узлы создаются сразу: Insert/Delete и ленивый список
+ * меняют их на месте, а отображение только для чтения.
+ */
+#define SNAPSHOT_MAGIC "LLSET01"
+
+struct snapshot_header_s {
+   char   magic[8];
+   long   count;
+};
+
+int Save_snapshot(const char* filename) {
+   struct snapshot_header_s hdr;
+   struct list_node_s* curr;
+   FILE* f = fopen(filename, "wb");
+
+   if (f == NULL) return -1;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+   for (curr = head; curr != NULL; curr = curr->next)
+      hdr.count++;
+   fwrite(&hdr, sizeof(hdr), 1, f);
+   for (curr = head; curr != NULL; curr = curr->next)
+      fwrite(&curr->data, sizeof(int), 1, f);
+   return fclose(f) == 0 ? 0 : -1;
+}  /* Save_snapshot */
+
+/* Возвращает число ключей или -1; список должен быть пуст */
+long Load_snapshot(const char* filename, int scatter) {
+   struct snapshot_header_s* hdr;
+   struct stat st;
+   const int* keys;
+   unsigned long stride = 1;
+   long i, n;
+   int fd = open(filename, O_RDONLY);
+
+   if (fd < 0) return -1;
+   if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(*hdr)) {
+      close(fd);
+      return -1;
+   }
+   hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (hdr == MAP_FAILED) return -1;
+   n = hdr->count;
+   /* n ограничивается размером файла до умножения, иначе n * sizeof(int)
+    * может переполниться и совпасть с размером */
+   if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || n < 0
+         || (unsigned long) n > (st.st_size - sizeof(*hdr)) / sizeof(int)
+         || st.st_size != (off_t) (sizeof(*hdr) + n * sizeof(int))) {
+      munmap(hdr, st.st_size);
+      return -1;
+   }
+   keys = (const int*) (hdr + 1);
+   madvise(hdr, st.st_size, MADV_SEQUENTIAL);
+
+   bulk_nodes = malloc((n + 1) * sizeof(struct list_node_s));
+   if (bulk_nodes == NULL) {
+      fprintf(stderr, "Can't allocate %ld list nodes\n", n);
+      munmap(hdr, st.st_size);
+      return -1;
+   }
+   bulk_count = n;
+   if (scatter && n > 1) {
+      stride = (unsigned long) (n * 0.6180339887) | 1;
+      while (Gcd(stride, n) != 1) stride += 2;
+   }
+   for (i = 0; i < n; i++) {
+      struct list_node_s* node = &bulk_nodes[i * stride % n];
+      if (keys[i] < 0 || keys[i] >= MAX_KEY || (i > 0 && keys[i - 1] >= keys[i])) {
+         munmap(hdr, st.st_size);
+         free(bulk_nodes);
+         bulk_nodes = NULL;
+         bulk_count = 0;
+         return -1;
+      }
+      node->data = keys[i];
+      node->marked = 0;
+      pthread_spin_init(&node->lock, PTHREAD_PROCESS_PRIVATE);
+      node->next = i + 1 < n ? &bulk_nodes[(i + 1) * stride % n] : NULL;
+   }
+   head = n > 0 ? bulk_nodes : NULL;
+   munmap(hdr, st.st_size);
+   return n;
+}  /* Load_snapshot */
+
+/* Узлы из блока Bulk_preload освобождаются вместе с блоком */
+void Free_node(struct list_node_s* node) {
+   if (node >= bulk_nodes && node < bulk_nodes + bulk_count)
+      return;
+   free(node);
+}  /* Free_node */
+
+/*-----------------------------------------------------------------*/
+/* Хэш-индекс для Member (ключ -H): открытая адресация с линейным
+ * пробированием по массиву int. Чтения без блокировок. Запись ключа k
+ * делается внутри той же критической секции, что меняет список, а она
+ * уже упорядочивает все записи одного ключа (wrlock, комбинирующий
+ * поток или блокировки pred/curr в ленивом списке). Разные ключи
+ * пишутся параллельно и занимают ячейки через CAS. Удаление оставляет
+ * HASH_DELETED, вставка может его переиспользовать. Размер не меняется:
+ * степень двойки не меньше 2 * (ключей после загрузки + вставок
+ * в нагрузке). Каждая занятая когда-либо ячейка — чья-то вставка,
+ * поэтому заполнение с учётом удалённых не выше 1/2. Сервер (-S) число
+ * вставок заранее не знает: когда занято 3/4 ячеек, индекс отключается
+ * (Hash_full) и Member снова идёт по списку, так что пустые ячейки
+ * остаются и пробирование всегда заканчивается.
+ */
+#define HASH_EMPTY    (-1)
+#define HASH_DELETED  (-2)
+
+/* Мультипликативное (фибоначчиево) хэширование: младшие биты
+ * произведения зависят только от младших битов ключа (ключи, кратные
+ * 1024, заняли бы 1/1024 таблицы), поэтому берутся старшие */
+static unsigned long Hash_slot(int key) {
+   return ((unsigned long) (unsigned) key * 0x9E3779B97F4A7C15ul) >> hash_shift;
+}
+
+/* Возвращает число ключей, перенесённых из списка */
+long Hash_init(long max_keys) {
+   unsigned long cap = 16;
+   struct list_node_s* curr;
+   long n = 0;
+
+   hash_shift = 60;
+   while (cap < 2 * (unsigned long) max_keys) {
+      cap *= 2;
+      hash_shift--;
+   }
+   hash_mask = cap - 1;
+   hash_slots = malloc(cap * sizeof(int));
+   if (hash_slots == NULL) {
+      fprintf(stderr, "Can't allocate hash index\n");
+      exit(1);
+   }
+   memset(hash_slots, 0xff, cap * sizeof(int));    // HASH_EMPTY
+   for (curr = head; curr != NULL; curr = curr->next, n++)
+      Hash_insert(curr->data);
+   return n;
+}  /* Hash_init */
+
+int Hash_member(int value) {
+   unsigned long i = Hash_slot(value);
+   int k;
+
+   while ((k = LOAD(hash_slots[i])) != HASH_EMPTY) {
+      if (k == value) return 1;
+      i = (i + 1) & hash_mask;
+   }
+   return 0;
+}  /* Hash_member */
+
+/* Вызывается, только если value в списке не было */
+void Hash_insert(int value) {
+   unsigned long i = Hash_slot(value);
+   int k;
+
+   for (;; i = (i + 1) & hash_mask) {
+      k = LOAD(hash_slots[i]);
+      if ((k == HASH_EMPTY || k == HASH_DELETED) &&
+            __atomic_compare_exchange_n(&hash_slots[i], &k, value, 0,
+                  __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+         if (k == HASH_EMPTY &&
+               __atomic_add_fetch(&hash_used, 1, __ATOMIC_RELAXED) == (long) (hash_mask + 1) / 4 * 3)
+            Hash_full();
+         return;
+      }
+   }
+}  /* Hash_insert */
+
+/* Вызывается, только если value был в списке */
+void Hash_delete(int value) {
+   unsigned long i = Hash_slot(value);
+   int k;
+
+   while ((k = LOAD(hash_slots[i])) != HASH_EMPTY) {
+      if (k == value) {
+         STORE(hash_slots[i], HASH_DELETED);
+         return;
+      }
+      i = (i + 1) & hash_mask;
+   }
+}  /* Hash_delete */
+
+/* Ровно один вызов: потоки, уже прочитавшие hash_enabled, ещё могут
+ * дописать по ключу, ячейки для этого остаются */
+void Hash_full(void) {
+   STORE(hash_enabled, 0);
+   fprintf(stderr, "Hash index is 3/4 full, Member falls back to the list\n");
+}  /* Hash_full */
+
+/*-----------------------------------------------------------------*/
+/* Отметки записей для RangeScan (только если в смеси есть сканы) */
+static void Write_begin(int value) {
+   if (scans_enabled)
+      __atomic_add_fetch(&scan_stripes[STRIPE(value)].begin, 1, __ATOMIC_SEQ_CST);
+}
+
+static void Write_end(int value) {
+   if (scans_enabled)
+      __atomic_add_fetch(&scan_stripes[STRIPE(value)].end, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Удалённый узел: пока по списку могут идти без блокировок (ленивый
+ * список, сканы), память освобождается только после потоков. Узлы
+ * копятся в буфере потока и сливаются в retired один раз в конце */
+static __thread struct list_node_s** my_retired = NULL;
+static __thread long my_retired_count = 0, my_retired_cap = 0;
+
+void Retire(struct list_node_s* node) {
+   if (my_retired_count == my_retired_cap) {
+      long cap = my_retired_cap ? 2 * my_retired_cap : 64;
+      struct list_node_s** buf = realloc(my_retired, cap * sizeof(struct list_node_s*));
+      if (buf == NULL) {
+         fprintf(stderr, "Can't grow retire buffer\n");
+         exit(1);
+      }
+      my_retired = buf;
+      my_retired_cap = cap;
+   }
+   my_retired[my_retired_count++] = node;
+}  /* Retire */
+
+/* Вызывается под count_mutex в конце потока */
+void Retire_merge(void) {
+   struct list_node_s** all = realloc(retired,
+         (retired_count + my_retired_count + 1) * sizeof(struct list_node_s*));
+   if (all == NULL) {
+      fprintf(stderr, "Can't grow retire buffer\n");
+      exit(1);
+   }
+   retired = all;
+   memcpy(retired + retired_count, my_retired, my_retired_count * sizeof(struct list_node_s*));
+   retired_count += my_retired_count;
+   free(my_retired);
+}  /* Retire_merge */
+
+void Dispose(struct list_node_s* node) {
+   if (scans_enabled)
+      Retire(node);
+   else
+      Free_node(node);
+}  /* Dispose */
+
+/*-----------------------------------------------------------------*/
+/* Ленивый список: Member идёт по списку без блокировок; Insert и Delete
+ * после оптимистичного прохода блокируют только pred и curr, проверяют,
+ * что оба не удалены и pred всё ещё указывает на curr, иначе начинают
+ * заново. Delete сначала помечает узел (логическое удаление), потом
+ * выкидывает его из списка. Память удалённых узлов не освобождается до
+ * конца работы потоков: по ним ещё могут идти читатели. pred == NULL
+ * означает указатель head под head_lock.
+ */
+int Lazy_member(int value) {
+   struct list_node_s* curr = LOAD(head);
+
+   while (curr != NULL && curr->data < value)
+      curr = LOAD(curr->next);
+
+   return curr != NULL && curr->data == value && !LOAD(curr->marked);
+}  /* Lazy_member */
+
+/* Блокировки pred и curr в порядке списка */
+static void Lazy_lock(struct list_node_s* pred, struct list_node_s* curr) {
+   pthread_spin_lock(pred == NULL ? &head_lock : &pred->lock);
+   if (curr != NULL) pthread_spin_lock(&curr->lock);
+}
+
+static void Lazy_unlock(struct list_node_s* pred, struct list_node_s* curr) {
+   if (curr != NULL) pthread_spin_unlock(&curr->lock);
+   pthread_spin_unlock(pred == NULL ? &head_lock : &pred->lock);
+}
+
+static int Lazy_validate(struct list_node_s* pred, struct list_node_s* curr) {
+   if (curr != NULL && curr->marked) return 0;
+   if (pred == NULL) return head == curr;
+   return !pred->marked && pred->next == curr;
+}
+
+/* Оптимистичный проход: pred — последний узел с data < value */
+static void Lazy_find(int value, struct list_node_s** pred_p, struct list_node_s** curr_p) {
+   struct list_node_s* pred = NULL;
+   struct list_node_s* curr = LOAD(head);
+
+   while (curr != NULL && curr->data < value) {
+      pred = curr;
+      curr = LOAD(curr->next);
+   }
+   *pred_p = pred;
+   *curr_p = curr;
+}
+
+int Lazy_insert(int value, long* retries_p) {
+   struct list_node_s *pred, *curr, *temp;
+   int rv;
+
+   for (;;) {
+      Lazy_find(value, &pred, &curr);
+      Lazy_lock(pred, curr);
+      if (Lazy_validate(pred, curr)) {
+         if (curr != NULL && curr->data == value) {
+            rv = 0;
+         } else {
+            temp = malloc(sizeof(struct list_node_s));
+            temp->data = value;
+            temp->marked = 0;
+            pthread_spin_init(&temp->lock, PTHREAD_PROCESS_PRIVATE);
+            temp->next = curr;
+            Write_begin(value);
+            if (pred == NULL)
+               STORE(head, temp);
+            else
+               STORE(pred->next, temp);
+            Write_end(value);
+            if (LOAD(hash_enabled)) Hash_insert(value);
+            rv = 1;
+         }
+         Lazy_unlock(pred, curr);
+         return rv;
+      }
+      Lazy_unlock(pred, curr);
+      (*retries_p)++;
+   }
+}  /* Lazy_insert */
+
+/* Удалённый узел уходит в Retire */
+int Lazy_delete(int value, long* retries_p) {
+   struct list_node_s *pred, *curr;
+   int rv;
+
+   for (;;) {
+      Lazy_find(value, &pred, &curr);
+      Lazy_lock(pred, curr);
+      if (Lazy_validate(pred, curr)) {
+         if (curr != NULL && curr->data == value) {
+            Write_begin(value);
+            STORE(curr->marked, 1);
+            if (pred == NULL)
+               STORE(head, curr->next);
+            else
+               STORE(pred->next, curr->next);
+            Write_end(value);
+            if (LOAD(hash_enabled)) Hash_delete(value);
+            rv = 1;
+         } else {
+            rv = 0;
+         }
+         Lazy_unlock(pred, curr);
+         if (rv) Retire(curr);
+         return rv;
+      }
+      Lazy_unlock(pred, curr);
+      (*retries_p)++;
+   }
+}  /* Lazy_delete */
+
+/*-----------------------------------------------------------------*/
+/* Flat combining: поток публикует Insert/Delete в своём слоте и либо
+ * становится комбинирующим (fc_lock свободен), либо ждёт, пока запрос
+ * выполнит другой. Комбинирующий собирает все опубликованные запросы,
+ * сортирует их по ключу и применяет за один проход по списку под
+ * блокировкой записи rwlock (Member идут под блокировкой чтения).
+ */
+struct fc_request_s {
+   int    value;
+   int    slot;
+};
+
+static int Fc_compare(const void* a, const void* b) {
+   const struct fc_request_s* x = a;
+   const struct fc_request_s* y = b;
+   if (x->value != y->value) return x->value < y->value ? -1 : 1;
+   return x->slot - y->slot;
+}
+
+void Fc_combine(void) {
+   struct fc_request_s* reqs = malloc(thread_count*sizeof(struct fc_request_s));
+   struct list_node_s *pred = NULL, *curr, *temp;
+   int i, n = 0;
+
+   for (i = 0; i < thread_count; i++)
+      if (LOAD(fc_slots[i].pending)) {
+         reqs[n].value = fc_slots[i].value;
+         reqs[n].slot = i;
+         n++;
+      }
+   if (n == 0) {
+      free(reqs);
+      return;
+   }
+   qsort(reqs, n, sizeof(struct fc_request_s), Fc_compare);
+
+   /* Один проход: pred — последний узел с data < value, curr — следующий */
+   pthread_rwlock_wrlock(&rwlock);
+   curr = head;
+   for (i = 0; i < n; i++) {
+      struct fc_slot_s* slot = &fc_slots[reqs[i].slot];
+      int value = reqs[i].value;
+      while (curr != NULL && curr->data < value) {
+         pred = curr;
+         curr = curr->next;
+      }
+      if (slot->op == FC_INSERT) {
+         if (curr == NULL || curr->data > value) {
+            temp = malloc(sizeof(struct list_node_s));
+            temp->data = value;
+            temp->marked = 0;
+            pthread_spin_init(&temp->lock, PTHREAD_PROCESS_PRIVATE);
+            temp->next = curr;
+            Write_begin(value);
+            if (pred == NULL)
+               STORE(head, temp);
+            else
+               STORE(pred->next, temp);
+            Write_end(value);
+            if (LOAD(hash_enabled)) Hash_insert(value);
+            curr = temp;
+            slot->result = 1;
+         } else {
+            slot->result = 0;
+         }
+      } else { /* FC_DELETE */
+         if (curr != NULL && curr->data == value) {
+            temp = curr;
+            curr = curr->next;
+            Write_begin(value);
+            if (pred == NULL)
+               STORE(head, curr);
+            else
+               STORE(pred->next, curr);
+            Write_end(value);
+            if (LOAD(hash_enabled)) Hash_delete(value);
+            Dispose(temp);
+            slot->result = 1;
+         } else {
+            slot->result = 0;
+         }
+      }
+   }
+   pthread_rwlock_unlock(&rwlock);
+
+   for (i = 0; i < n; i++)
+      STORE(fc_slots[reqs[i].slot].pending, 0);
+
+   fc_passes++;
+   fc_requests += n;
+   if (n > fc_max_batch) fc_max_batch = n;
+   free(reqs);
+}  /* Fc_combine */
+
+int Fc_apply(long my_rank, int op, int value) {
+   struct fc_slot_s* slot = &fc_slots[my_rank];
+
+   slot->op = op;
+   slot->value = value;
+   STORE(slot->pending, 1);
+
+   for (;;) {
+      if (pthread_mutex_trylock(&fc_lock) == 0) {
+         Fc_combine();
+         pthread_mutex_unlock(&fc_lock);
+      }
+      if (!LOAD(slot->pending)) break;
+      sched_yield();
+   }
+   return slot->result;
+}  /* Fc_apply */
+
+/*-----------------------------------------------------------------*/
+/* Группа поисков за один проход (ключ -g). В упорядоченном списке все
+ * поиски начинаются с head и идут по общему префиксу, поэтому G
+ * чередующихся обходов просили бы на каждом шаге один и тот же узел.
+ * Вместо этого ключи группы сортируются, и один проход отвечает на все:
+ * G обходов в среднем по n/2 узлов заменяются одним до наибольшего
+ * ключа. found[i] — ответ для values[i].
+ * Возвращает число найденных.
+ */
+int Member_batch(const int* values, int* found, int count) {
+   int order[BATCH_MAX];
+   int i, j, k, v, hits = 0;
+   struct list_node_s* curr;
+
+   /* Вставками: count не больше BATCH_MAX */
+   for (i = 0; i < count; i++) {
+      for (j = i; j > 0 && values[order[j - 1]] > values[i]; j--)
+         order[j] = order[j - 1];
+      order[j] = i;
+   }
+
+   curr = LOAD(head);
+   for (k = 0; k < count; k++) {
+      v = values[order[k]];
+      while (curr != NULL && curr->data < v)
+         curr = LOAD(curr->next);
+      found[order[k]] = curr != NULL && curr->data == v && !LOAD(curr->marked);
+      hits += found[order[k]];
+   }
+   return hits;
+}  /* Member_batch */
+
+/*-----------------------------------------------------------------*/
+/* Ключи [lo, hi] собираются в буфер потока; callback вызывается для
+ * них по возрастанию уже после проверки, т. е. ровно один раз на
+ * согласованном состоянии. Писатели сканом не блокируются: при
+ * пересечении с записью скан повторяется, а после SCAN_RETRIES неудач
+ * в режимах rwlock и fc проходит под rdlock. В ленивом списке rwlock
+ * писатели не берут, там скан повторяется до успеха.
+ * Возвращает число ключей.
+ */
+static __thread int* scan_buf = NULL;
+static __thread int  scan_buf_cap = 0;
+
+static int Scan_collect(int lo, int hi) {
+   struct list_node_s* curr = LOAD(head);
+   int n = 0;
+
+   while (curr != NULL && curr->data < lo)
+      curr = LOAD(curr->next);
+   while (curr != NULL && curr->data <= hi) {
+      if (!LOAD(curr->marked)) {
+         if (n == scan_buf_cap) {
+            int cap = scan_buf_cap ? 2 * scan_buf_cap : 256;
+            int* buf = realloc(scan_buf, cap * sizeof(int));
+            if (buf == NULL) {
+               fprintf(stderr, "Can't grow scan buffer\n");
+               exit(1);
+            }
+            scan_buf = buf;
+            scan_buf_cap = cap;
+         }
+         scan_buf[n++] = curr->data;
+      }
+      curr = LOAD(curr->next);
+   }
+   return n;
+}
+
+int RangeScan(int lo, int hi, void (*callback)(int key, void* arg), void* arg,
+      long* retries_p, long* fallbacks_p) {
+   int s, s_lo, s_hi, n, attempt;
+   long begin_sum, end_sum, check_sum;
+
+   if (hi >= MAX_KEY) hi = MAX_KEY - 1;
+   s_lo = STRIPE(lo);
+   s_hi = STRIPE(hi);
+   for (attempt = 0; ; attempt++) {
+      if (attempt >= SCAN_RETRIES && mode != MODE_LAZY) {
+         pthread_rwlock_rdlock(&rwlock);
+         n = Scan_collect(lo, hi);
+         pthread_rwlock_unlock(&rwlock);
+         (*fallbacks_p)++;
+         break;
+      }
+      if (attempt >= SCAN_RETRIES) sched_yield();
+
+      /* begin читается раньше end: равенство сумм означает, что ни в
+       * одной полосе нет незавершённой записи (если begin потом не
+       * изменится) */
+      begin_sum = end_sum = 0;
+      for (s = s_lo; s <= s_hi; s++) {
+         begin_sum += __atomic_load_n(&scan_stripes[s].begin, __ATOMIC_SEQ_CST);
+         end_sum += __atomic_load_n(&scan_stripes[s].end, __ATOMIC_SEQ_CST);
+      }
+      if (begin_sum == end_sum) {
+         n = Scan_collect(lo, hi);
+         check_sum = 0;
+         for (s = s_lo; s <= s_hi; s++)
+            check_sum += __atomic_load_n(&scan_stripes[s].begin, __ATOMIC_SEQ_CST);
+         if (check_sum == begin_sum) break;
+      }
+      (*retries_p)++;
+   }
+
+   for (s = 0; s < n; s++)
+      callback(scan_buf[s], arg);
+   return n;
+}  /* RangeScan */
+
+static void Scan_count_key(int key, void* arg) {
+   (void) key;
+   (*(long*) arg)++;
+}
+
+/*-----------------------------------------------------------------*/
+/* Одна операция OP_MEMBER, OP_INSERT или OP_DELETE в выбранном режиме;
+ * возвращает результат Member/Insert/Delete */
+int List_apply(long my_rank, int op, int val, long* retries_p) {
+   int rv;
+
+   if (op == OP_MEMBER) {
+      if (LOAD(hash_enabled))
+         return Hash_member(val);
+      if (mode == MODE_LAZY)
+         return Lazy_member(val);
+      pthread_rwlock_rdlock(&rwlock);
+      rv = Member(val);
+      pthread_rwlock_unlock(&rwlock);
+   } else if (op == OP_INSERT) {
+      if (mode == MODE_LAZY)
+         return Lazy_insert(val, retries_p);
+      if (mode == MODE_FC)
+         return Fc_apply(my_rank, FC_INSERT, val);
+      pthread_rwlock_wrlock(&rwlock);
+      Write_begin(val);
+      rv = Insert(val);
+      if (rv && LOAD(hash_enabled)) Hash_insert(val);
+      Write_end(val);
+      pthread_rwlock_unlock(&rwlock);
+   } else { /* delete */
+      if (mode == MODE_LAZY)
+         return Lazy_delete(val, retries_p);
+      if (mode == MODE_FC)
+         return Fc_apply(my_rank, FC_DELETE, val);
+      pthread_rwlock_wrlock(&rwlock);
+      Write_begin(val);
+      rv = Delete(val);
+      if (rv && LOAD(hash_enabled)) Hash_delete(val);
+      Write_end(val);
+      pthread_rwlock_unlock(&rwlock);
+   }
+   return rv;
+}  /* List_apply */
+
+/* Member_batch под блокировкой чтения (в ленивом списке — без неё) */
+void Member_group(const int* values, int* found, int count) {
+   if (mode == MODE_LAZY) {
+      Member_batch(values, found, count);
+   } else {
+      pthread_rwlock_rdlock(&rwlock);
+      Member_batch(values, found, count);
+      pthread_rwlock_unlock(&rwlock);
+   }
+}  /* Member_group */
+
+/*-----------------------------------------------------------------*/
+/* Сервер (ключ -S path): операции над списком по протоколу ll_proto.h.
+ * Главный поток принимает соединения и раздаёт их по кругу thread_count
+ * рабочим; у каждого рабочего свой epoll. Всё, что пришло в сокет,
+ * читается за раз и выполняется пачкой: подряд идущие Member — одним
+ * Member_group (с -g), остальные — List_apply с номером рабочего (для
+ * слотов flat combining). Ответы пачки уходят одним write; если сокет
+ * не принял всё, соединение ждёт EPOLLOUT и пока не читается.
+ * Остановка — SIGINT/SIGTERM или запрос LL_SHUTDOWN.
+ */
+struct conn_s {
+   int    fd;
+   int    in_len;                  // Байт в in (хвост — неполный запрос)
+   int    out_len, out_pos;        // Неотправленные ответы out[out_pos..out_len)
+   char   in[SERVER_BUF];
+   unsigned char out[SERVER_BUF / sizeof(struct ll_request_s)];
+};
+
+volatile sig_atomic_t server_stop = 0;
+int*        server_epfd;            // epoll рабочего
+struct      conn_s** server_conns = NULL;   // По fd, для закрытия в конце
+int         server_conns_cap = 0;
+pthread_mutex_t server_conns_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void Server_signal(int sig) {
+   (void) sig;
+   server_stop = 1;
+}
+
+static void Conn_close(long my_rank, struct conn_s* c) {
+   epoll_ctl(server_epfd[my_rank], EPOLL_CTL_DEL, c->fd, NULL);
+   pthread_mutex_lock(&server_conns_mutex);
+   server_conns[c->fd] = NULL;
+   pthread_mutex_unlock(&server_conns_mutex);
+   close(c->fd);
+   free(c);
+}
+
+/* 0 — всё отправлено, 1 — сокет полон, -1 — ошибка */
+static int Conn_flush(struct conn_s* c) {
+   while (c->out_pos < c->out_len) {
+      ssize_t w = write(c->fd, c->out + c->out_pos, c->out_len - c->out_pos);
+      if (w < 0)
+         return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+      c->out_pos += w;
+   }
+   c->out_len = c->out_pos = 0;
+   return 0;
+}
+
+/* Выполнить полные запросы из in, ответы — в out */
+static int Conn_execute(long my_rank, struct conn_s* c, long* counts, long* retries_p) {
+   int n = c->in_len / sizeof(struct ll_request_s), i = 0, j;
+   struct ll_request_s req;
+   int keys[BATCH_MAX], found[BATCH_MAX];
+
+   while (i < n) {
+      memcpy(&req, c->in + i * sizeof(req), sizeof(req));
+      if (req.op == LL_SHUTDOWN) {
+         server_stop = 1;
+         i++;
+      } else if (req.op == OP_MEMBER && member_batch > 1 && !LOAD(hash_enabled)) {
+         int g = 0;
+         while (g < member_batch && i < n && req.op == OP_MEMBER) {
+            keys[g++] = req.key;
+            if (++i < n) memcpy(&req, c->in + i * sizeof(req), sizeof(req));
+         }
+         Member_group(keys, found, g);
+         for (j = 0; j < g; j++)
+            c->out[c->out_len++] = found[j];
+         counts[OP_MEMBER] += g;
+      } else if (req.op <= OP_DELETE) {
+         c->out[c->out_len++] = List_apply(my_rank, req.op, req.key, retries_p);
+         counts[req.op]++;
+         i++;
+      } else {
+         return -1;
+      }
+   }
+   memmove(c->in, c->in + n * sizeof(req), c->in_len - n * sizeof(req));
+   c->in_len -= n * sizeof(req);
+   return 0;
+}
+
+/* 0 — ждать запросов, 1 — ждать EPOLLOUT, -1 — закрыть */
+static int Conn_serve(long my_rank, struct conn_s* c, long* counts, long* retries_p) {
+   ssize_t r;
+   int rv;
+
+   for (;;) {
+      r = read(c->fd, c->in + c->in_len, SERVER_BUF - c->in_len);
+      if (r == 0) return -1;
+      if (r < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+      c->in_len += r;
+      if (Conn_execute(my_rank, c, counts, retries_p) != 0) return -1;
+      if ((rv = Conn_flush(c)) != 0) return rv;
+   }
+}
+
+void* Server_work(void* rank) {
+   long my_rank = (long) rank;
+   struct epoll_event events[SERVER_EVENTS], ev;
+   long counts[3] = {0, 0, 0}, my_retries = 0;
+   int n, k, rv;
+
+   while (!server_stop) {
+      n = epoll_wait(server_epfd[my_rank], events, SERVER_EVENTS, 100);
+      for (k = 0; k < n; k++) {
+         struct conn_s* c = events[k].data.ptr;
+         if (events[k].events & EPOLLOUT) {
+            rv = Conn_flush(c);
+            if (rv == 0) rv = Conn_serve(my_rank, c, counts, &my_retries);
+         } else {
+            rv = Conn_serve(my_rank, c, counts, &my_retries);
+         }
+         if (rv < 0) {
+            Conn_close(my_rank, c);
+         } else if ((rv == 1) != ((events[k].events & EPOLLOUT) != 0)) {
+            ev.events = rv == 1 ? EPOLLOUT : EPOLLIN;
+            ev.data.ptr = c;
+            epoll_ctl(server_epfd[my_rank], EPOLL_CTL_MOD, c->fd, &ev);
+         }
+      }
+   }
+
+   pthread_mutex_lock(&count_mutex);
+   member_count += counts[OP_MEMBER];
+   insert_count += counts[OP_INSERT];
+   delete_count += counts[OP_DELETE];
+   retry_count += my_retries;
+   Retire_merge();
+   pthread_mutex_unlock(&count_mutex);
+   free(scan_buf);
+   return NULL;
+}  /* Server_work */
+
+int Serve(const char* path) {
+   struct sockaddr_un addr;
+   struct epoll_event ev;
+   pthread_t* handles = malloc(thread_count * sizeof(pthread_t));
+   int listen_fd, accept_epfd, fd, next = 0;
+   long i;
+
+   listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+   unlink(path);
+   if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0
+         || listen(listen_fd, SOMAXCONN) != 0) {
+      perror(path);
+      free(handles);
+      return -1;
+   }
+   signal(SIGPIPE, SIG_IGN);
+   signal(SIGINT, Server_signal);
+   signal(SIGTERM, Server_signal);
+
+   accept_epfd = epoll_create1(0);
+   ev.events = EPOLLIN;
+   ev.data.fd = listen_fd;
+   epoll_ctl(accept_epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+   server_epfd = malloc(thread_count * sizeof(int));
+   for (i = 0; i < thread_count; i++) {
+      server_epfd[i] = epoll_create1(0);
+      pthread_create(&handles[i], NULL, Server_work, (void*) i);
+   }
+   printf("Serving on %s with %d workers\n", path, thread_count);
+   fflush(stdout);
+
+   while (!server_stop) {
+      if (epoll_wait(accept_epfd, &ev, 1, 100) <= 0) continue;
+      while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+         struct conn_s* c = malloc(sizeof(struct conn_s));
+         fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+         c->fd = fd;
+         c->in_len = c->out_len = c->out_pos = 0;
+         pthread_mutex_lock(&server_conns_mutex);
+         if (fd >= server_conns_cap) {
+            int old = server_conns_cap;
+            server_conns_cap = 2 * fd + 16;
+            server_conns = realloc(server_conns, server_conns_cap * sizeof(struct conn_s*));
+            memset(server_conns + old, 0, (server_conns_cap - old) * sizeof(struct conn_s*));
+         }
+         server_conns[fd] = c;
+         pthread_mutex_unlock(&server_conns_mutex);
+         ev.events = EPOLLIN;
+         ev.data.ptr = c;
+         epoll_ctl(server_epfd[next], EPOLL_CTL_ADD, fd, &ev);
+         next = (next + 1) % thread_count;
+      }
+   }
+
+   for (i = 0; i < thread_count; i++) {
+      pthread_join(handles[i], NULL);
+      close(server_epfd[i]);
+   }
+   for (i = 0; i < server_conns_cap; i++)
+      if (server_conns[i] != NULL) {
+         close(server_conns[i]->fd);
+         free(server_conns[i]);
+      }
+   free(server_conns);
+   free(server_epfd);
+   close(accept_epfd);
+   close(listen_fd);
+   unlink(path);
+   free(handles);
+   return 0;
+}  /* Serve */
+
 /*-----------------------------------------------------------------*/
 void* Thread_work(void* rank) {
    long my_rank = (long) rank;
    int i, val;
-   double which_op;
-   unsigned seed = my_rank + 1;
+   struct workload_s* my_work = &work[my_rank];
    int my_member_count = 0, my_insert_count=0, my_delete_count=0;
-   int ops_per_thread = total_ops/thread_count;
+   long my_retries = 0;
+   int my_scan_count = 0;
+   long my_scanned_keys = 0, my_scan_retries = 0, my_scan_fallbacks = 0;
 
-   for (i = 0; i < ops_per_thread; i++) {
-      which_op = my_drand(&seed);
-      val = my_rand(&seed) % MAX_KEY;
-      if (which_op < search_percent) {
-         pthread_rwlock_rdlock(&rwlock);
-         Member(val);
-         pthread_rwlock_unlock(&rwlock);
-         my_member_count++;
-      } else if (which_op < search_percent + insert_percent) {
-         pthread_rwlock_wrlock(&rwlock);
-         Insert(val);
-         pthread_rwlock_unlock(&rwlock);
-         my_insert_count++;
-      } else { /* delete */
-         pthread_rwlock_wrlock(&rwlock);
-         Delete(val);
-         pthread_rwlock_unlock(&rwlock);
-         my_delete_count++;
+   for (i = 0; i < my_work->count; i++) {
+      val = my_work->keys[i];
+      if (my_work->ops[i] == OP_MEMBER && member_batch > 1 && !LOAD(hash_enabled)) {
+         /* До member_batch подряд идущих Member (записи не переставляются) */
+         int n = 1, found[BATCH_MAX];
+         while (n < member_batch && i + n < my_work->count && my_work->ops[i + n] == OP_MEMBER)
+            n++;
+         Member_group(&my_work->keys[i], found, n);
+         my_member_count += n;
+         i += n - 1;
+      } else if (my_work->ops[i] == OP_SCAN) {
+         RangeScan(val, val + (scan_width - 1), Scan_count_key, &my_scanned_keys,
+               &my_scan_retries, &my_scan_fallbacks);
+         my_scan_count++;
+      } else {
+         List_apply(my_rank, my_work->ops[i], val, &my_retries);
+         if (my_work->ops[i] == OP_MEMBER)
+            my_member_count++;
+         else if (my_work->ops[i] == OP_INSERT)
+            my_insert_count++;
+         else
+            my_delete_count++;
       }
    }  /* for */
 
@@ -287,7 +1599,14 @@ void* Thread_work(void* rank) {
    member_count += my_member_count;
    insert_count += my_insert_count;
    delete_count += my_delete_count;
+   retry_count += my_retries;
+   scan_count += my_scan_count;
+   scanned_keys += my_scanned_keys;
+   scan_retries += my_scan_retries;
+   scan_fallbacks += my_scan_fallbacks;
+   Retire_merge();
    pthread_mutex_unlock(&count_mutex);
+   free(scan_buf);
 
    return NULL;
 }  /* Thread_work */
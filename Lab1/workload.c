@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "my_rand.h"
+#include "workload.h"
+
+/*-----------------------------------------------------------------*/
+/* Распределение Зипфа по рангам 1..n методом rejection-inversion
+ * (Hörmann, Derflinger): O(1) на выборку, без суммы zeta(n).
+ */
+struct zipf_s {
+   double n, s;
+   double h_integral_x1, h_integral_n, sdiv;
+};
+
+static double Zipf_helper1(double x) {
+   return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double Zipf_helper2(double x) {
+   return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+static double Zipf_h(struct zipf_s* z, double x) {
+   return exp(-z->s * log(x));
+}
+
+static double Zipf_h_integral(struct zipf_s* z, double x) {
+   double log_x = log(x);
+   return Zipf_helper2((1.0 - z->s) * log_x) * log_x;
+}
+
+static double Zipf_h_integral_inverse(struct zipf_s* z, double x) {
+   double t = x * (1.0 - z->s);
+   if (t < -1.0) t = -1.0;
+   return exp(Zipf_helper1(t) * x);
+}
+
+static void Zipf_init(struct zipf_s* z, int n, double s) {
+   z->n = n;
+   z->s = s;
+   z->h_integral_x1 = Zipf_h_integral(z, 1.5) - 1.0;
+   z->h_integral_n = Zipf_h_integral(z, n + 0.5);
+   z->sdiv = 2.0 - Zipf_h_integral_inverse(z, Zipf_h_integral(z, 2.5) - Zipf_h(z, 2.0));
+}
+
+static long Zipf_sample(struct zipf_s* z, unsigned* seed_p) {
+   for (;;) {
+      double u = z->h_integral_n + my_drand(seed_p) * (z->h_integral_x1 - z->h_integral_n);
+      double x = Zipf_h_integral_inverse(z, u);
+      long k = (long) (x + 0.5);
+      if (k < 1) k = 1;
+      else if (k > z->n) k = (long) z->n;
+      if (k - x <= z->sdiv || u >= Zipf_h_integral(z, k + 0.5) - Zipf_h(z, k))
+         return k;
+   }
+}
+
+/*-----------------------------------------------------------------*/
+static int Workload_alloc(struct workload_s* w, int count) {
+   w->count = count;
+   w->ops = malloc(count + 1);
+   w->keys = malloc((count + 1) * sizeof(int));
+   return w->ops != NULL && w->keys != NULL ? 0 : -1;
+}
+
+/* Перестановка в phases фаз: чтения и записи потока по очереди, каждая
+ * фаза чтения (записи) получает равную часть всех чтений (записей) */
+static void Workload_phases(struct workload_s* w, int phases) {
+   char* ops = malloc(w->count + 1);
+   int* keys = malloc((w->count + 1) * sizeof(int));
+   int reads = 0, writes = 0, i, p;
+
+   for (i = 0; i < w->count; i++)
+      if (OP_IS_READ(w->ops[i])) reads++;
+   writes = w->count - reads;
+
+   int read_phases = (phases + 1) / 2, write_phases = phases / 2;
+   int r = 0, wr = 0, out = 0, ri = 0, wi = 0;
+   for (p = 0; p < phases; p++) {
+      int is_read = (p % 2 == 0);
+      int k = p / 2;
+      int limit = is_read ? (long) reads * (k + 1) / read_phases
+                          : (long) writes * (k + 1) / write_phases;
+      /* Следующие операции нужного типа в исходном порядке */
+      while ((is_read ? r : wr) < limit) {
+         if (is_read) {
+            while (!OP_IS_READ(w->ops[ri])) ri++;
+            ops[out] = w->ops[ri];
+            keys[out++] = w->keys[ri++];
+            r++;
+         } else {
+            while (OP_IS_READ(w->ops[wi])) wi++;
+            ops[out] = w->ops[wi];
+            keys[out++] = w->keys[wi++];
+            wr++;
+         }
+      }
+   }
+
+   free(w->ops);
+   free(w->keys);
+   w->ops = ops;
+   w->keys = keys;
+}
+
+/*-----------------------------------------------------------------*/
+int Workload_generate(struct workload_s* work, int thread_count, int total_ops,
+      double search_percent, double insert_percent, double scan_percent, int max_key,
+      const char* spec, int phases) {
+   int kind;                       // 0 uniform, 1 zipf, 2 hotspot, 3 seq
+   double theta = 0.99, hot_frac = 0.01, hot_prob = 0.9;
+   struct zipf_s zipf;
+   long t;
+   int i;
+
+   if (strcmp(spec, "uniform") == 0) {
+      kind = 0;
+   } else if (strncmp(spec, "zipf", 4) == 0) {
+      kind = 1;
+      if (spec[4] == ':') theta = atof(spec + 5);
+      if (theta <= 0.0) return -1;
+      Zipf_init(&zipf, max_key, theta);
+   } else if (strncmp(spec, "hotspot", 7) == 0) {
+      kind = 2;
+      if (spec[7] == ':' && sscanf(spec + 8, "%lf:%lf", &hot_frac, &hot_prob) != 2) return -1;
+      if (hot_frac <= 0.0 || hot_frac > 1.0) return -1;
+   } else if (strcmp(spec, "seq") == 0) {
+      kind = 3;
+   } else {
+      return -1;
+   }
+
+   int ops_per_thread = total_ops / thread_count;
+   int hot_keys = (int) (hot_frac * max_key);
+   if (hot_keys < 1) hot_keys = 1;
+   int hot_start = (max_key - hot_keys) / 2;
+
+   for (t = 0; t < thread_count; t++) {
+      struct workload_s* w = &work[t];
+      unsigned seed = t + 1;        // Как в исходном Thread_work
+      unsigned scan_seed = thread_count + t + 1;
+      if (Workload_alloc(w, ops_per_thread) != 0) return -1;
+
+      for (i = 0; i < ops_per_thread; i++) {
+         double which_op = my_drand(&seed);
+         int val;
+         switch (kind) {
+         case 1:
+            /* Ранг 1 — самый частый; умножение на нечётное взаимно
+             * простое с max_key число раскидывает ранги по ключам */
+            val = (int) (((Zipf_sample(&zipf, &seed) - 1) * 2654435761ULL) % max_key);
+            break;
+         case 2:
+            if (my_drand(&seed) < hot_prob)
+               val = hot_start + my_rand(&seed) % hot_keys;
+            else
+               val = my_rand(&seed) % max_key;
+            break;
+         case 3:
+            val = (int) ((t * (long) (max_key / thread_count) + i) % max_key);
+            break;
+         default:
+            val = my_rand(&seed) % max_key;
+         }
+         w->keys[i] = val;
+         if (which_op < search_percent)
+            w->ops[i] = scan_percent > 0.0 && my_drand(&scan_seed) < scan_percent
+                      ? OP_SCAN : OP_MEMBER;
+         else if (which_op < search_percent + insert_percent)
+            w->ops[i] = OP_INSERT;
+         else
+            w->ops[i] = OP_DELETE;
+      }
+
+      if (phases > 1)
+         Workload_phases(w, phases);
+   }
+   return 0;
+}  /* Workload_generate */
+
+/*-----------------------------------------------------------------*/
+int Workload_load_trace(struct workload_s* work, int thread_count, const char* filename) {
+   FILE* f = fopen(filename, "rb");
+   long records, i;
+   int t, rec[2];
+
+   if (f == NULL) return -1;
+   fseek(f, 0, SEEK_END);
+   records = ftell(f) / sizeof(rec);
+   fseek(f, 0, SEEK_SET);
+
+   for (t = 0; t < thread_count; t++)
+      if (Workload_alloc(&work[t], records / thread_count + (t < records % thread_count)) != 0) {
+         fclose(f);
+         return -1;
+      }
+
+   for (i = 0; i < records; i++) {
+      struct workload_s* w = &work[i % thread_count];
+      if (fread(rec, sizeof(rec), 1, f) != 1 || rec[0] < OP_MEMBER || rec[0] > OP_SCAN) {
+         fclose(f);
+         return -1;
+      }
+      w->ops[i / thread_count] = (char) rec[0];
+      w->keys[i / thread_count] = rec[1];
+   }
+   fclose(f);
+   return 0;
+}  /* Workload_load_trace */
+
+/*-----------------------------------------------------------------*/
+int Workload_save_trace(struct workload_s* work, int thread_count, const char* filename) {
+   FILE* f = fopen(filename, "wb");
+   int i, t, max_count = 0, rec[2];
+
+   if (f == NULL) return -1;
+   for (t = 0; t < thread_count; t++)
+      if (work[t].count > max_count) max_count = work[t].count;
+
+   /* Вперемешку по потокам, чтобы Workload_load_trace вернул то же */
+   for (i = 0; i < max_count; i++)
+      for (t = 0; t < thread_count; t++)
+         if (i < work[t].count) {
+            rec[0] = work[t].ops[i];
+            rec[1] = work[t].keys[i];
+            fwrite(rec, sizeof(rec), 1, f);
+         }
+   return fclose(f) == 0 ? 0 : -1;
+}  /* Workload_save_trace */
+
+/*-----------------------------------------------------------------*/
+void Workload_free(struct workload_s* work, int thread_count) {
+   int t;
+   for (t = 0; t < thread_count; t++) {
+      free(work[t].ops);
+      free(work[t].keys);
+   }
+}  /* Workload_free */
@@ -0,0 +1,44 @@
+#ifndef _WORKLOAD_H_
+#define _WORKLOAD_H_
+
+/* Операции в потоке запросов */
+#define OP_MEMBER 0
+#define OP_INSERT 1
+#define OP_DELETE 2
+#define OP_SCAN   3     // RangeScan(key, key + ширина - 1), ширину задаёт программа
+
+#define OP_IS_READ(op) ((op) == OP_MEMBER || (op) == OP_SCAN)
+
+/* Заранее сгенерированные операции одного потока */
+struct workload_s {
+   int     count;
+   char*   ops;     // OP_MEMBER, OP_INSERT, OP_DELETE или OP_SCAN
+   int*    keys;
+};
+
+/* Генерация ops_per_thread = total_ops / thread_count операций на поток.
+ * spec — распределение ключей:
+ *    uniform            равномерно (как раньше my_rand % max_key)
+ *    zipf:THETA         Зипф с показателем THETA по max_key ключам,
+ *                       ранги перемешаны по пространству ключей
+ *    hotspot:FRAC:PROB  доля PROB запросов в горячий диапазон из
+ *                       FRAC * max_key ключей посередине
+ *    seq                каждый поток идёт по ключам подряд со своего места
+ * scan_percent — доля поисков, заменяемых на OP_SCAN (отдельный генератор,
+ * так что при 0 поток операций не меняется).
+ * phases > 1 — операции потока переставляются в phases чередующихся фаз:
+ * только чтения, затем только записи и т. д. (доли операций сохраняются).
+ * Возвращает 0 или -1 при ошибке в spec.
+ */
+int  Workload_generate(struct workload_s* work, int thread_count, int total_ops,
+      double search_percent, double insert_percent, double scan_percent, int max_key,
+      const char* spec, int phases);
+
+/* Бинарный трейс: записи из двух int (op, key) в порядке платформы.
+ * Запись i достаётся потоку i % thread_count. Возвращают 0 или -1. */
+int  Workload_load_trace(struct workload_s* work, int thread_count, const char* filename);
+int  Workload_save_trace(struct workload_s* work, int thread_count, const char* filename);
+
+void Workload_free(struct workload_s* work, int thread_count);
+
+#endif
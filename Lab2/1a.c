@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mpi.h>
+#include <omp.h>
+#include "iter_service.h"
 
 void PrintMatrix(int* mat, int rows, int cols, int rank) {
     printf("My rank: %d Matrix: \n", rank);
@@ -89,6 +92,7 @@ void PrintVector(int *v, int n, int my_rank) {
 void MatVecMult(int *mat, int *vec, int *res, int local_r, int c, int my_rank) {
     // PrintMatrix(mat, local_r, c, my_rank);
     // PrintVector2(vec, c, my_rank);
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < local_r; i++) {
         res[i] = 0;
         for (int j = 0; j < c; j++) {
@@ -97,6 +101,103 @@ void MatVecMult(int *mat, int *vec, int *res, int local_r, int c, int my_rank) {
     }
 }
 
+// Строки first_row .. first_row + local_r - 1 матрицы r x c
+void GenerateLocalRows(int *mat, int local_r, int c, int first_row) {
+    for (int i = 0; i < local_r; i++) {
+        for (int j = 0; j < c; j++) {
+            mat[i * c + j] = GenValue(first_row + i, j);
+        }
+    }
+}
+
+// Режим замера: матрица не создаётся на корне и не печатается, вектор
+// строит каждый процесс. Замеряются только MatVecMult и сбор результата
+// MPI_Gatherv, iters повторов после одного прогревочного
+void Benchmark(int r, int c, int iters, int comm_sz, int my_rank, int *sizes_vec, int *displs_vec) {
+    int local_r = sizes_vec[my_rank];
+    int *mat = malloc((size_t)local_r * c * sizeof(int));
+    int *vec = malloc(c * sizeof(int));
+    int *res = calloc(local_r + 1, sizeof(int));
+    int *full_res = my_rank == 0 ? malloc(r * sizeof(int)) : NULL;
+
+    GenerateLocalRows(mat, local_r, c, displs_vec[my_rank]);
+    for (int j = 0; j < c; j++) {
+        vec[j] = GenValue(-1, j);
+    }
+
+    double elapsed = 0.0;
+    for (int it = 0; it <= iters; it++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        MatVecMult(mat, vec, res, local_r, c, my_rank);
+        MPI_Gatherv(res, local_r, MPI_INT, full_res, sizes_vec, displs_vec, MPI_INT, 0, MPI_COMM_WORLD);
+        if (it > 0) { // нулевой проход — прогрев
+            elapsed += MPI_Wtime() - start;
+        }
+    }
+
+    if (my_rank == 0) {
+        long long checksum = 0;
+        for (int i = 0; i < r; i++) {
+            checksum += full_res[i];
+        }
+        double per_iter = elapsed / iters;
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", comm_sz, omp_get_max_threads());
+        printf("Matrix %dx%d, %d iterations\n", r, c, iters);
+        printf("Time per product: %f seconds, %f GFLOP/s\n", per_iter, 2.0 * r * c / per_iter / 1e9);
+        printf("Checksum: %lld\n", checksum);
+    }
+
+    free(mat);
+    free(vec);
+    free(res);
+    free(full_res);
+}
+
+// Режим сервиса: квадратная матрица n x n остаётся на процессах (строки
+// генерируются на месте), к ней k раз применяется умножение
+// x <- (A * x) mod 10 (mod — чтобы значения оставались в int). Между
+// итерациями нужен только MPI_Allgatherv кусков нового вектора.
+void IterativeService(int n, int k, int comm_sz, int my_rank, int *sizes_vec, int *displs_vec) {
+    int local_r = sizes_vec[my_rank];
+    int *mat = malloc((size_t)local_r * n * sizeof(int));
+    int *x = malloc(n * sizeof(int));
+    int *y = calloc(local_r + 1, sizeof(int));
+    double *lat = malloc(k * sizeof(double));
+
+    GenerateLocalRows(mat, local_r, n, displs_vec[my_rank]);
+    for (int j = 0; j < n; j++) {
+        x[j] = GenValue(-1, j);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int t = 0; t < k; t++) {
+        double start = MPI_Wtime();
+        MatVecMult(mat, x, y, local_r, n, my_rank);
+        for (int i = 0; i < local_r; i++) {
+            y[i] %= 10;
+        }
+        MPI_Allgatherv(y, local_r, MPI_INT, x, sizes_vec, displs_vec, MPI_INT, MPI_COMM_WORLD);
+        lat[t] = MPI_Wtime() - start;
+    }
+
+    if (my_rank == 0) {
+        long long checksum = 0;
+        for (int i = 0; i < n; i++) {
+            checksum += x[i];
+        }
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", comm_sz, omp_get_max_threads());
+        printf("Matrix %dx%d, %d iterations\n", n, n, k);
+        PrintLatency(lat, k);
+        printf("Checksum: %lld\n", checksum);
+    }
+
+    free(mat);
+    free(x);
+    free(y);
+    free(lat);
+}
+
 void BuildSize(int r, int c, int comm_sz, int *sizes) {
     for (int i = 0; i < comm_sz; i++) {
         sizes[i] = r / comm_sz;
@@ -114,12 +215,67 @@ void BuildDisplacements(int comm_sz, int *displs, int *sizes) {
     }
 }
 
-int main() {
+int main(int argc, char **argv) {
     int comm_sz, my_rank;
-    MPI_Init(NULL, NULL);
+    // Потоки OpenMP делят строки в MatVecMult, MPI — только из главного потока
+    int provided;
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "MPI_THREAD_FUNNELED is not supported\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
+    // mpirun ./1a bench [rows] [cols] [iters] — замер без ввода и печати
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int r = argc > 2 ? atoi(argv[2]) : 4096;
+        int c = argc > 3 ? atoi(argv[3]) : r;
+        int iters = argc > 4 ? atoi(argv[4]) : 100;
+        if (r < 1 || c < 1 || iters < 1) {
+            if (my_rank == 0) {
+                printf("Usage: %s bench [rows >= 1] [cols >= 1] [iters >= 1]\n", argv[0]);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        int *sizes_vec = calloc(comm_sz, sizeof(int));
+        int *displacements_vec = calloc(comm_sz, sizeof(int));
+        BuildSize(r, 1, comm_sz, sizes_vec);
+        BuildDisplacements(comm_sz, displacements_vec, sizes_vec);
+
+        Benchmark(r, c, iters, comm_sz, my_rank, sizes_vec, displacements_vec);
+
+        free(sizes_vec);
+        free(displacements_vec);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // mpirun ./1a iter [n] [k] — k умножений на резидентную матрицу n x n
+    if (argc > 1 && strcmp(argv[1], "iter") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 4096;
+        int k = argc > 3 ? atoi(argv[3]) : 1000;
+        if (n < 1 || k < 1) {
+            if (my_rank == 0) {
+                printf("Usage: %s iter [n >= 1] [k >= 1]\n", argv[0]);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        int *sizes_vec = calloc(comm_sz, sizeof(int));
+        int *displacements_vec = calloc(comm_sz, sizeof(int));
+        BuildSize(n, 1, comm_sz, sizes_vec);
+        BuildDisplacements(comm_sz, displacements_vec, sizes_vec);
+
+        IterativeService(n, k, comm_sz, my_rank, sizes_vec, displacements_vec);
+
+        free(sizes_vec);
+        free(displacements_vec);
+        MPI_Finalize();
+        return 0;
+    }
+
     double start_time = MPI_Wtime();
 
     int r, c;
@@ -159,6 +315,7 @@ int main() {
 
     if (my_rank == 0) {
         double end_time = MPI_Wtime();
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", comm_sz, omp_get_max_threads());
         printf("Elapsed time: %f seconds\n", end_time - start_time);
     }
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <mpi.h>
+#include <omp.h>
 
 void PrintMatrix(int* mat, int rows, int cols, int rank) {
     printf("My rank: %d Matrix: \n", rank);
@@ -81,9 +82,8 @@ void DistributeVectorColumns(int *vec, int *local_vec, int cols, int comm_sz, in
     free(displs);
 }
 
-void PartialMatVecMult(int *local_mat, int *local_vec, int *local_res, int rows, int local_cols, int my_rank) {
-    PrintMatrix(local_mat, rows, local_cols, my_rank);
-    PrintVector(local_vec, rows, my_rank);
+void PartialMatVecMult(int *local_mat, int *local_vec, int *local_res, int rows, int local_cols) {
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < rows; i++) {
         for (int j = 0; j < local_cols; j++) {
             local_res[i] += local_mat[i * local_cols + j] * local_vec[j];
@@ -120,7 +120,13 @@ int main()
 {
     int my_rank, comm_sz;
 
-    MPI_Init(NULL, NULL);
+    // Потоки OpenMP только в локальном умножении, MPI — из главного потока
+    int provided;
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "MPI_THREAD_FUNNELED is not supported\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
 
@@ -131,6 +137,8 @@ int main()
     double start, finish;
     double full_start, full_finish;
 
+    full_start = MPI_Wtime();
+
     int cols_per_proc = cols / comm_sz + (my_rank < cols % comm_sz ? 1 : 0);
     int *local_mat = malloc(rows * cols_per_proc * sizeof(int));
     int *local_vec = malloc(cols_per_proc * sizeof(int));
@@ -168,7 +176,9 @@ int main()
         DistributeVectorColumns(NULL, local_vec, cols, comm_sz, my_rank);
     }
 
-    PartialMatVecMult(local_mat, local_vec, local_res, rows, cols_per_proc, my_rank);
+    start = MPI_Wtime();
+
+    PartialMatVecMult(local_mat, local_vec, local_res, rows, cols_per_proc);
 
     if (my_rank == 0) {
         final_res = calloc(rows, sizeof(int));
@@ -176,9 +186,17 @@ int main()
 
     CollectPartialResults(local_res, final_res, rows, comm_sz, my_rank);
 
+    finish = MPI_Wtime();
+    full_finish = MPI_Wtime();
 
     PrintResult(final_res, rows, my_rank);
 
+    if (my_rank == 0) {
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", comm_sz, omp_get_max_threads());
+        printf("Compute + reduce time: %f seconds\n", finish - start);
+        printf("Total time: %f seconds\n", full_finish - full_start);
+    }
+
     free(local_mat);
     free(local_vec);
     free(local_res);
@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mpi.h>
+#include <omp.h>
 #include "./timer.h"
+#include "iter_service.h"
 
 void PrintMatrix(int* mat, int rows, int cols, int rank) {
     printf("My rank: %d Matrix: \n", rank);
@@ -41,6 +44,10 @@ void InputVector(int *vec, int size) {
     }
 }
 
+// Рассылка блоков столбцов: у процесса i — cols_i подряд идущих столбцов
+// матрицы rows x cols, локально по строкам (rows x cols_i). Отправляемый
+// тип — один столбец матрицы, принимаемый — один столбец локального блока,
+// оба с экстентом в один int, чтобы счёт и смещения шли в столбцах.
 void DistributeMatrixColumns(int *matrix, int *local_mat, int rows, int cols, int comm_sz, int my_rank) {
     int cols_per_proc = cols / comm_sz;
     int remainder = cols % comm_sz;
@@ -50,13 +57,25 @@ void DistributeMatrixColumns(int *matrix, int *local_mat, int rows, int cols, in
 
     int offset = 0;
     for (int i = 0; i < comm_sz; i++) {
-        sendcounts[i] = rows * (cols_per_proc + (i < remainder ? 1 : 0));
+        sendcounts[i] = cols_per_proc + (i < remainder ? 1 : 0);
         displs[i] = offset;
         offset += sendcounts[i];
     }
 
-    MPI_Scatterv(matrix, sendcounts, displs, MPI_INT, local_mat, sendcounts[my_rank], MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Datatype tmp, col_type, local_col_type;
+    MPI_Type_vector(rows, 1, cols, MPI_INT, &tmp);
+    MPI_Type_create_resized(tmp, 0, sizeof(int), &col_type);
+    MPI_Type_free(&tmp);
+    MPI_Type_vector(rows, 1, sendcounts[my_rank], MPI_INT, &tmp);
+    MPI_Type_create_resized(tmp, 0, sizeof(int), &local_col_type);
+    MPI_Type_free(&tmp);
+    MPI_Type_commit(&col_type);
+    MPI_Type_commit(&local_col_type);
+
+    MPI_Scatterv(matrix, sendcounts, displs, col_type, local_mat, sendcounts[my_rank], local_col_type, 0, MPI_COMM_WORLD);
 
+    MPI_Type_free(&col_type);
+    MPI_Type_free(&local_col_type);
     free(sendcounts);
     free(displs);
 }
@@ -82,6 +101,7 @@ void DistributeVectorColumns(int *vec, int *local_vec, int cols, int comm_sz, in
 }
 
 void PartialMatVecMult(int *local_mat, int *local_vec, int *local_res, int rows, int local_cols) {
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < rows; i++) {
         for (int j = 0; j < local_cols; j++) {
             local_res[i] += local_mat[i * local_cols + j] * local_vec[j];
@@ -89,21 +109,92 @@ void PartialMatVecMult(int *local_mat, int *local_vec, int *local_res, int rows,
     }
 }
 
-void CollectPartialResults(int *local_res, int *final_res, int rows, int comm_sz, int my_rank) {
-    int *recvcounts = malloc(comm_sz * sizeof(int));
+// Сложение частичных сумм с раздачей результата по строкам: процесс i
+// получает в res_piece свои rows_i элементов (MPI_Reduce_scatter), так
+// что объём на процесс не растёт с числом процессов. Если gather, куски
+// дополнительно собираются в final_res на ранге 0.
+void CollectPartialResults(int *local_res, int *res_piece, int *final_res, int rows, int comm_sz, int my_rank, int gather) {
+    int *counts = malloc(comm_sz * sizeof(int));
     int *displs = malloc(comm_sz * sizeof(int));
 
+    int offset = 0;
     for (int i = 0; i < comm_sz; i++) {
-        recvcounts[i] = rows;
-        displs[i] = i * rows;
+        counts[i] = rows / comm_sz + (i < rows % comm_sz ? 1 : 0);
+        displs[i] = offset;
+        offset += counts[i];
     }
 
-    MPI_Reduce(local_res, final_res, rows, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce_scatter(local_res, res_piece, counts, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (gather) {
+        MPI_Gatherv(res_piece, counts[my_rank], MPI_INT, final_res, counts, displs, MPI_INT, 0, MPI_COMM_WORLD);
+    }
 
-    free(recvcounts);
+    free(counts);
     free(displs);
 }
 
+// Режим сервиса: у каждого процесса остаются свои столбцы квадратной
+// матрицы n x n и такой же кусок вектора x. k раз применяется
+// x <- (A * x) mod 10: частичные суммы по всем строкам складываются
+// MPI_Reduce_scatter так, что каждый получает ровно свой кусок нового x.
+void IterativeService(int n, int k, int comm_sz, int my_rank) {
+    int *counts = malloc(comm_sz * sizeof(int));
+    int first_col = 0;
+    for (int i = 0; i < comm_sz; i++) {
+        counts[i] = n / comm_sz + (i < n % comm_sz ? 1 : 0);
+        if (i < my_rank) {
+            first_col += counts[i];
+        }
+    }
+    int local_cols = counts[my_rank];
+
+    int *local_mat = malloc((size_t)n * local_cols * sizeof(int));
+    int *local_x = malloc((local_cols + 1) * sizeof(int));
+    int *partial = malloc(n * sizeof(int));
+    double *lat = malloc(k * sizeof(double));
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < local_cols; j++) {
+            local_mat[i * local_cols + j] = GenValue(i, first_col + j);
+        }
+    }
+    for (int j = 0; j < local_cols; j++) {
+        local_x[j] = GenValue(-1, first_col + j);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int t = 0; t < k; t++) {
+        double start, finish;
+        GET_TIME(start);
+        memset(partial, 0, n * sizeof(int));
+        PartialMatVecMult(local_mat, local_x, partial, n, local_cols);
+        MPI_Reduce_scatter(partial, local_x, counts, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        for (int j = 0; j < local_cols; j++) {
+            local_x[j] %= 10;
+        }
+        GET_TIME(finish);
+        lat[t] = finish - start;
+    }
+
+    long long local_sum = 0, checksum = 0;
+    for (int j = 0; j < local_cols; j++) {
+        local_sum += local_x[j];
+    }
+    MPI_Reduce(&local_sum, &checksum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (my_rank == 0) {
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", comm_sz, omp_get_max_threads());
+        printf("Matrix %dx%d, %d iterations\n", n, n, k);
+        PrintLatency(lat, k);
+        printf("Checksum: %lld\n", checksum);
+    }
+
+    free(counts);
+    free(local_mat);
+    free(local_x);
+    free(partial);
+    free(lat);
+}
+
 void PrintResult(int *res, int rows, int my_rank) {
     if (my_rank == 0) {
         printf("Result vector:\n");
@@ -114,14 +205,39 @@ void PrintResult(int *res, int rows, int my_rank) {
     }
 }
 
-int main()
+int main(int argc, char **argv)
 {
     int my_rank, comm_sz;
 
-    MPI_Init(NULL, NULL);
+    // Потоки OpenMP только в PartialMatVecMult, MPI — из главного потока
+    int provided;
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "MPI_THREAD_FUNNELED is not supported\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
 
+    // mpirun ./1bN2 iter [n] [k] — k умножений на резидентную матрицу n x n
+    if (argc > 1 && strcmp(argv[1], "iter") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 4096;
+        int k = argc > 3 ? atoi(argv[3]) : 1000;
+        if (n < 1 || k < 1) {
+            if (my_rank == 0) {
+                printf("Usage: %s iter [n >= 1] [k >= 1]\n", argv[0]);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        IterativeService(n, k, comm_sz, my_rank);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // mpirun ./1bN2 nogather — результат остаётся распределённым по строкам
+    int gather = !(argc > 1 && strcmp(argv[1], "nogather") == 0);
+
     int rows, cols;
     InputDim(&rows, my_rank);
     InputDim(&cols, my_rank);
@@ -135,6 +251,7 @@ int main()
     int *local_mat = malloc(rows * cols_per_proc * sizeof(int));
     int *local_vec = malloc(cols_per_proc * sizeof(int));
     int *local_res = calloc(rows, sizeof(int));
+    int *res_piece = malloc((rows / comm_sz + 1) * sizeof(int));
     int *final_res = NULL;
 
     if (my_rank == 0) {
@@ -175,16 +292,25 @@ int main()
         final_res = calloc(rows, sizeof(int));
     }
 
-    CollectPartialResults(local_res, final_res, rows, comm_sz, my_rank);
+    CollectPartialResults(local_res, res_piece, final_res, rows, comm_sz, my_rank, gather);
 
     GET_TIME(finish);
     GET_TIME(full_finish);
 
-    PrintResult(final_res, rows, my_rank);
+    if (gather) {
+        PrintResult(final_res, rows, my_rank);
+    }
+
+    if (my_rank == 0) {
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", comm_sz, omp_get_max_threads());
+        printf("Compute + reduce time: %f seconds\n", finish - start);
+        printf("Total time: %f seconds\n", full_finish - full_start);
+    }
 
     free(local_mat);
     free(local_vec);
     free(local_res);
+    free(res_piece);
     if (my_rank == 0) {
         free(final_res);
     }
@@ -1,15 +1,29 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-void matrix_vector_column_split(int* mat, int* vec, int* result, int rows, int cols, int rank, int size) {
+// Умножение с разбиением по столбцам. Частичные суммы складываются
+// MPI_Reduce_scatter: процесс получает в result_piece свои строки
+// результата (rows / size, остаток — первым процессам). Если gather,
+// куски собираются в result на ранге 0.
+void matrix_vector_column_split(int* mat, int* vec, int* result, int* result_piece, int rows, int cols, int rank, int size, int gather) {
     int cols_per_proc = cols / size;
     int* local_mat = (int*)malloc(rows * cols_per_proc * sizeof(int));
     int* local_result = (int*)calloc(rows, sizeof(int));
     int* local_vec = (int*)malloc(cols_per_proc * sizeof(int));
 
-    MPI_Scatter(mat, rows * cols_per_proc, MPI_INT, local_mat, rows * cols_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
+    // Блок из cols_per_proc столбцов матрицы; экстент — cols_per_proc int,
+    // так что блок процесса i начинается со столбца i * cols_per_proc
+    MPI_Datatype tmp, col_block;
+    MPI_Type_vector(rows, cols_per_proc, cols, MPI_INT, &tmp);
+    MPI_Type_create_resized(tmp, 0, cols_per_proc * sizeof(int), &col_block);
+    MPI_Type_commit(&col_block);
+    MPI_Type_free(&tmp);
+
+    MPI_Scatter(mat, 1, col_block, local_mat, rows * cols_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Scatter(vec, cols_per_proc, MPI_INT, local_vec, cols_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&col_block);
 
     for (int i = 0; i < rows; i++) {
         for (int j = 0; j < cols_per_proc; j++) {
@@ -17,8 +31,22 @@ void matrix_vector_column_split(int* mat, int* vec, int* result, int rows, int c
         }
     }
 
-    MPI_Reduce(local_result, result, rows, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    int* counts = (int*)malloc(size * sizeof(int));
+    int* displs = (int*)malloc(size * sizeof(int));
+    int offset = 0;
+    for (int i = 0; i < size; i++) {
+        counts[i] = rows / size + (i < rows % size ? 1 : 0);
+        displs[i] = offset;
+        offset += counts[i];
+    }
+
+    MPI_Reduce_scatter(local_result, result_piece, counts, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (gather) {
+        MPI_Gatherv(result_piece, counts[rank], MPI_INT, result, counts, displs, MPI_INT, 0, MPI_COMM_WORLD);
+    }
 
+    free(counts);
+    free(displs);
     free(local_mat);
     free(local_result);
     free(local_vec);
@@ -31,6 +59,9 @@ int main(int argc, char** argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+    // mpirun ./1bpred nogather — результат остаётся распределённым по строкам
+    int gather = !(argc > 1 && strcmp(argv[1], "nogather") == 0);
+
     int rows, cols;
     int* mat = NULL;
     int* vec = NULL;
@@ -60,14 +91,21 @@ int main(int argc, char** argv) {
         }
     }
 
-    matrix_vector_column_split(mat, vec, result, rows, cols, rank, size);
+    MPI_Bcast(&rows, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&cols, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int* result_piece = (int*)malloc((rows / size + 1) * sizeof(int));
+
+    matrix_vector_column_split(mat, vec, result, result_piece, rows, cols, rank, size, gather);
+    free(result_piece);
 
     if (rank == 0) {
-        printf("Result: ");
-        for (int i = 0; i < rows; i++) {
-            printf("%d ", result[i]);
+        if (gather) {
+            printf("Result: ");
+            for (int i = 0; i < rows; i++) {
+                printf("%d ", result[i]);
+            }
+            printf("\n");
         }
-        printf("\n");
 
         free(mat);
         free(vec);
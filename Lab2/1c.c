@@ -1,7 +1,10 @@
 #include <mpi.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "iter_service.h"
 
 void PrintMatrix(int* mat, int rows, int cols, int rank) {
     printf("My rank: %d Matrix: \n", rank);
@@ -42,29 +45,188 @@ void InputDim(int *n, int my_rank) {
     MPI_Bcast(n, 1, MPI_INT, 0, MPI_COMM_WORLD);
 }
 
-void matrix_vector_block_split(int* mat, int* vec, int* result, int rows, int cols, int* dip_cols, int* dip_rows, int my_rank, int size) {
-    int* local_result = (int*)calloc(rows, sizeof(int));
+// Решётка sq_size x sq_size без перенумерации (ранг = block_r * sq_size + block_c)
+// и её подкоммуникаторы: row_comm — строка решётки (ранг = block_c),
+// col_comm — столбец (ранг = block_r)
+void create_grid(int sq_size, MPI_Comm *grid_comm, MPI_Comm *row_comm, MPI_Comm *col_comm) {
+    int dims[2] = {sq_size, sq_size};
+    int periods[2] = {0, 0};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, grid_comm);
+    MPI_Cart_sub(*grid_comm, (int[]){0, 1}, row_comm);
+    MPI_Cart_sub(*grid_comm, (int[]){1, 0}, col_comm);
+}
+
+// Рассылка блоков матрицы rows x cols с ранга 0: каждому процессу уходит
+// только его подматрица (тип subarray), принимается она подряд по строкам
+void distribute_matrix_blocks(int* mat, int* block, int rows, int cols, int* block_rows, int* dip_rows,
+                              int* block_cols, int* dip_cols, MPI_Comm grid_comm) {
+    int rank, size, coords[2];
+    MPI_Comm_rank(grid_comm, &rank);
+    MPI_Comm_size(grid_comm, &size);
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+
+    MPI_Request* reqs = NULL;
+    MPI_Datatype* types = NULL;
+    int nreqs = 0;
+    if (rank == 0) {
+        reqs = (MPI_Request*)malloc(size * sizeof(MPI_Request));
+        types = (MPI_Datatype*)malloc(size * sizeof(MPI_Datatype));
+        for (int r = 0; r < size; r++) {
+            int c[2];
+            MPI_Cart_coords(grid_comm, r, 2, c);
+            if (block_rows[c[0]] == 0 || block_cols[c[1]] == 0) {
+                continue;
+            }
+            int sizes[2] = {rows, cols};
+            int subsizes[2] = {block_rows[c[0]], block_cols[c[1]]};
+            int starts[2] = {dip_rows[c[0]], dip_cols[c[1]]};
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_INT, &types[nreqs]);
+            MPI_Type_commit(&types[nreqs]);
+            MPI_Isend(mat, 1, types[nreqs], r, 0, grid_comm, &reqs[nreqs]);
+            nreqs++;
+        }
+    }
+
+    int count = block_rows[coords[0]] * block_cols[coords[1]];
+    if (count > 0) {
+        MPI_Recv(block, count, MPI_INT, 0, 0, grid_comm, MPI_STATUS_IGNORE);
+    }
+
+    if (rank == 0) {
+        MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+        for (int i = 0; i < nreqs; i++) {
+            MPI_Type_free(&types[i]);
+        }
+        free(reqs);
+        free(types);
+    }
+}
+
+// Кусок вектора для столбцов block_c: ранг 0 раздаёт куски по первой
+// строке решётки, дальше каждый кусок рассылается вниз по столбцу
+void distribute_vector(int* vec, int* x, int* block_cols, int* dip_cols, int block_r, int block_c,
+                       MPI_Comm row_comm, MPI_Comm col_comm) {
+    if (block_r == 0) {
+        MPI_Scatterv(vec, block_cols, dip_cols, MPI_INT, x, block_cols[block_c], MPI_INT, 0, row_comm);
+    }
+    MPI_Bcast(x, block_cols[block_c], MPI_INT, 0, col_comm);
+}
+
+// Умножение с блочным 2D разбиением: частичные суммы блока сводятся по
+// строке решётки (row_comm) в её первый столбец, куски результата
+// собираются по первому столбцу (col_comm) в result на ранге 0
+void matrix_vector_block_2d(int* block, int* x, int* result, int* block_rows, int* dip_rows, int* block_cols,
+                            int block_r, int block_c, MPI_Comm row_comm, MPI_Comm col_comm) {
+    int local_rows = block_rows[block_r], local_cols = block_cols[block_c];
+    int* partial = (int*)calloc(local_rows + 1, sizeof(int));
+    int* piece = (int*)calloc(local_rows + 1, sizeof(int));
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < local_rows; i++) {
+        for (int j = 0; j < local_cols; j++) {
+            partial[i] += block[i * local_cols + j] * x[j];
+        }
+    }
+
+    MPI_Reduce(partial, piece, local_rows, MPI_INT, MPI_SUM, 0, row_comm);
+    if (block_c == 0) {
+        MPI_Gatherv(piece, local_rows, MPI_INT, result, block_rows, dip_rows, MPI_INT, 0, col_comm);
+    }
+
+    free(partial);
+    free(piece);
+}
 
-    
+// Режим сервиса на решётке sq_size x sq_size: у процесса (block_r, block_c)
+// остаётся свой блок квадратной матрицы n x n и кусок x для столбцов
+// block_c. k раз применяется x <- (A * x) mod 10: частичные суммы блока
+// сводятся по строке решётки (row_comm) на диагональный процесс, у него
+// получается кусок нового x для столбцов block_r = block_c, и он рассылает
+// его вниз по своему столбцу (col_comm).
+void iterative_service(int n, int k, int my_rank, int size) {
     int sq_size = (int)sqrt(size);
-    int block_r = (int)(my_rank / (sq_size) );
-    int block_c = (int)(my_rank % (sq_size) );
-    
-    for (int i = dip_rows[block_r]; i < (block_r == sq_size-1 ? rows : dip_rows[block_r+1]); i++) {
-        for (int j = dip_cols[block_c]; j < (block_c == sq_size-1 ? cols : dip_cols[block_c+1]); j++) {
-            local_result[i] += mat[i*cols+j] * vec[j];
-            if (my_rank==1){
-                //printf("My rank: %d x  %d %d\n", my_rank, mat[i*cols+j], vec[j]);
+    int block_r = my_rank / sq_size;
+    int block_c = my_rank % sq_size;
+
+    int *block_sizes = calloc(sq_size, sizeof(int));
+    int *dip = calloc(sq_size, sizeof(int));
+    BuildSize(n, sq_size, block_sizes);
+    BuildDisplacements(sq_size, dip, block_sizes);
+    int local_rows = block_sizes[block_r], local_cols = block_sizes[block_c];
+
+    MPI_Comm grid_comm, row_comm, col_comm;
+    create_grid(sq_size, &grid_comm, &row_comm, &col_comm);
+
+    int *block = malloc((size_t)local_rows * local_cols * sizeof(int));
+    int *x = malloc((local_cols + 1) * sizeof(int));
+    int *partial = malloc((local_rows + 1) * sizeof(int));
+    double *lat = malloc(k * sizeof(double));
+    for (int i = 0; i < local_rows; i++) {
+        for (int j = 0; j < local_cols; j++) {
+            block[i * local_cols + j] = GenValue(dip[block_r] + i, dip[block_c] + j);
+        }
+    }
+    for (int j = 0; j < local_cols; j++) {
+        x[j] = GenValue(-1, dip[block_c] + j);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int t = 0; t < k; t++) {
+        double start = MPI_Wtime();
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < local_rows; i++) {
+            int sum = 0;
+            for (int j = 0; j < local_cols; j++) {
+                sum += block[i * local_cols + j] * x[j];
+            }
+            partial[i] = sum;
+        }
+        // Корень row_comm — процесс с block_c == block_r
+        MPI_Reduce(block_r == block_c ? MPI_IN_PLACE : partial, partial, local_rows, MPI_INT, MPI_SUM, block_r, row_comm);
+        if (block_r == block_c) {
+            for (int j = 0; j < local_cols; j++) {
+                x[j] = partial[j] % 10;
             }
         }
+        MPI_Bcast(x, local_cols, MPI_INT, block_c, col_comm);
+        lat[t] = MPI_Wtime() - start;
+    }
+
+    long long local_sum = 0, checksum = 0;
+    if (block_r == block_c) {
+        for (int j = 0; j < local_cols; j++) {
+            local_sum += x[j];
+        }
     }
-    MPI_Reduce(local_result, result, rows, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&local_sum, &checksum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
 
-    free(local_result);
+    if (my_rank == 0) {
+        printf("MPI processes: %d (%dx%d grid), OpenMP threads per process: %d\n",
+               size, sq_size, sq_size, omp_get_max_threads());
+        printf("Matrix %dx%d, %d iterations\n", n, n, k);
+        PrintLatency(lat, k);
+        printf("Checksum: %lld\n", checksum);
+    }
+
+    free(block_sizes);
+    free(dip);
+    free(block);
+    free(x);
+    free(partial);
+    free(lat);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    MPI_Comm_free(&grid_comm);
 }
 
-int main() {
-    MPI_Init(NULL, NULL);
+int main(int argc, char** argv) {
+    // Потоки OpenMP делят строки блока, MPI — только из главного потока
+    int provided;
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "MPI_THREAD_FUNNELED is not supported\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -80,12 +242,28 @@ int main() {
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+    // mpirun ./1c iter [n] [k] — k умножений на резидентную матрицу n x n
+    if (argc > 1 && strcmp(argv[1], "iter") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 4096;
+        int k = argc > 3 ? atoi(argv[3]) : 1000;
+        if (n < 1 || k < 1) {
+            if (rank == 0) {
+                printf("Usage: %s iter [n >= 1] [k >= 1]\n", argv[0]);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        iterative_service(n, k, rank, size);
+        MPI_Finalize();
+        return 0;
+    }
+
     int rows, cols;
     InputDim(&rows, rank);
     InputDim(&cols, rank);
 
-    int* mat = (int*)malloc(rows * cols * sizeof(int));
-    int* vec = (int*)malloc(cols * sizeof(int));
+    int* mat = NULL;
+    int* vec = NULL;
     int* result = NULL;
 
 
@@ -99,9 +277,20 @@ int main() {
     BuildSize(cols, sq_size, block_cols);
     BuildDisplacements(sq_size, dip_cols, block_cols);
 
+    // Решётка sq_size x sq_size: процесс (block_r, block_c) хранит только
+    // свой блок матрицы и кусок вектора для своих столбцов
+    MPI_Comm grid_comm, row_comm, col_comm;
+    create_grid(sq_size, &grid_comm, &row_comm, &col_comm);
+    int block_r = rank / sq_size;
+    int block_c = rank % sq_size;
+    int* block = (int*)malloc((block_rows[block_r] * block_cols[block_c] + 1) * sizeof(int));
+    int* x = (int*)malloc((block_cols[block_c] + 1) * sizeof(int));
+
     MPI_Barrier(MPI_COMM_WORLD);
 
     if (rank == 0) {
+        mat = (int*)malloc(rows * cols * sizeof(int));
+        vec = (int*)malloc(cols * sizeof(int));
         result = (int*)malloc(rows * sizeof(int));
 
         for (int i = 0; i < rows; i++) {
@@ -114,13 +303,24 @@ int main() {
             vec[i] = rand() % 10;
         }
     }
-    
-    MPI_Bcast(mat, rows*cols, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(vec, cols, MPI_INT, 0, MPI_COMM_WORLD);
-    matrix_vector_block_split(mat, vec, result, rows, cols, dip_rows, dip_cols, rank, size);
+
+    distribute_matrix_blocks(mat, block, rows, cols, block_rows, dip_rows, block_cols, dip_cols, grid_comm);
+    distribute_vector(vec, x, block_cols, dip_cols, block_r, block_c, row_comm, col_comm);
+    matrix_vector_block_2d(block, x, result, block_rows, dip_rows, block_cols, block_r, block_c, row_comm, col_comm);
+
+    free(block);
+    free(x);
+    free(block_rows);
+    free(dip_rows);
+    free(block_cols);
+    free(dip_cols);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    MPI_Comm_free(&grid_comm);
 
     if (rank == 0) {
         double end_time = MPI_Wtime();
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", size, omp_get_max_threads());
         printf("Elapsed time: %f seconds\n", end_time - start_time);
         // printf("Matrix: \n");
         // for (int i = 0; i < rows; i++) {
@@ -3,6 +3,21 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Блокировка локального умножения блоков (элементы int)
+#define GEMM_MR 4    // Строк C в микроядре
+#define GEMM_NR 16   // Столбцов C в микроядре (два вектора AVX2 по 8 int)
+#define GEMM_KC 256  // Глубина панели: MR x KC из A и KC x NR из B лежат в L1
+#define GEMM_MC 64   // Строк упакованного блока A (MC x KC — в L2)
+#define GEMM_NC 1024 // Столбцов упакованной панели B (KC x NC — в L3)
+
+#define SUMMA_KB 256 // Наибольшая ширина панели SUMMA (как глубина GEMM_KC)
+
+#define PRINT_MAX 20 // Матрицы печатаются, только если n не больше
 
 void PrintMatrix(int* mat, int rows, int cols, int rank) {
     printf("My rank: %d Matrix: \n", rank);
@@ -35,96 +50,661 @@ void print_matrix(int* mat, int rows, int cols) {
     }
 }
 
-void cannon_algorithm(int* A, int* B, int* C, int n, int sqrt_p, int rank) {
-    int block_size = n / sqrt_p; // Размер блока
-    int* local_A = (int*)malloc(block_size * block_size * sizeof(int));
-    int* local_B = (int*)malloc(block_size * block_size * sizeof(int));
-    int* local_C = (int*)calloc(block_size * block_size, sizeof(int));
+// Упаковка блока A (mc x kc, шаг строки lda) в панели по GEMM_MR строк:
+// внутри панели элементы идут по k, затем по строкам. Неполная панель
+// дополняется нулями.
+void pack_A(const int* A, int lda, int mc, int kc, int* packed) {
+    for (int i0 = 0; i0 < mc; i0 += GEMM_MR) {
+        for (int k = 0; k < kc; k++) {
+            for (int i = 0; i < GEMM_MR; i++) {
+                *packed++ = i0 + i < mc ? A[(i0 + i) * lda + k] : 0;
+            }
+        }
+    }
+}
 
-    MPI_Comm grid_comm, row_comm, col_comm;
+// Упаковка панели B (kc x nc, шаг строки ldb) в полосы по GEMM_NR столбцов
+void pack_B(const int* B, int ldb, int kc, int nc, int* packed) {
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+        for (int k = 0; k < kc; k++) {
+            for (int j = 0; j < GEMM_NR; j++) {
+                *packed++ = j0 + j < nc ? B[k * ldb + j0 + j] : 0;
+            }
+        }
+    }
+}
 
-    // Создаём декартовую топологию процессов
-    int dims[2] = {sqrt_p, sqrt_p};
-    int periods[2] = {1, 1}; // Замкнутая топология (циклический сдвиг)
-    int coords[2];
-    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &grid_comm);
+// Микроядро: C[MR x NR] += A_panel * B_panel по kc. Полный тайл пишется
+// прямо в C, неполный (mr < MR или nr < NR) — через временный буфер.
+void gemm_micro_kernel(int kc, const int* a, const int* b, int* C, int ldc, int mr, int nr) {
+    int tile[GEMM_MR * GEMM_NR];
+#ifdef __AVX2__
+    __m256i c[GEMM_MR][2];
+    for (int i = 0; i < GEMM_MR; i++) {
+        c[i][0] = _mm256_setzero_si256();
+        c[i][1] = _mm256_setzero_si256();
+    }
+    for (int k = 0; k < kc; k++) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(b + k * GEMM_NR));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + k * GEMM_NR + 8));
+        for (int i = 0; i < GEMM_MR; i++) {
+            __m256i ai = _mm256_set1_epi32(a[k * GEMM_MR + i]);
+            c[i][0] = _mm256_add_epi32(c[i][0], _mm256_mullo_epi32(ai, b0));
+            c[i][1] = _mm256_add_epi32(c[i][1], _mm256_mullo_epi32(ai, b1));
+        }
+    }
+    for (int i = 0; i < GEMM_MR; i++) {
+        _mm256_storeu_si256((__m256i*)(tile + i * GEMM_NR), c[i][0]);
+        _mm256_storeu_si256((__m256i*)(tile + i * GEMM_NR + 8), c[i][1]);
+    }
+#else
+    for (int i = 0; i < GEMM_MR * GEMM_NR; i++) {
+        tile[i] = 0;
+    }
+    for (int k = 0; k < kc; k++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            for (int j = 0; j < GEMM_NR; j++) {
+                tile[i * GEMM_NR + j] += a[k * GEMM_MR + i] * b[k * GEMM_NR + j];
+            }
+        }
+    }
+#endif
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            C[i * ldc + j] += tile[i * GEMM_NR + j];
+        }
+    }
+}
+
+// Локальное умножение C += A * B, где A — m x k (шаг строки lda),
+// B — k x n (ldb), C — m x n (ldc), с упаковкой и блокировкой под кэши
+// L1/L2/L3 и микроядром AVX2 (без AVX2 — скалярным).
+// Буферы упаковки фиксированного размера выделяются при первом вызове
+// и живут до конца программы (вызов на каждом шаге Кэннона/SUMMA).
+void local_gemm_mnk(const int* A, int lda, const int* B, int ldb, int* C, int ldc, int m, int n, int k) {
+    static int* packed_A = NULL;
+    static int* packed_B = NULL;
+    if (packed_A == NULL) {
+        if (posix_memalign((void**)&packed_A, 64, (size_t)GEMM_MC * GEMM_KC * sizeof(int)) != 0 ||
+            posix_memalign((void**)&packed_B, 64, (size_t)GEMM_KC * (GEMM_NC + GEMM_NR) * sizeof(int)) != 0) {
+            fprintf(stderr, "local_gemm: cannot allocate packing buffers\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+            pack_B(B + pc * ldb + jc, ldb, kc, nc, packed_B);
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+                pack_A(A + ic * lda + pc, lda, mc, kc, packed_A);
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        gemm_micro_kernel(kc, packed_A + ir * kc, packed_B + jr * kc,
+                                          C + (ic + ir) * ldc + jc + jr, ldc,
+                                          mc - ir < GEMM_MR ? mc - ir : GEMM_MR,
+                                          nc - jr < GEMM_NR ? nc - jr : GEMM_NR);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Локальное умножение квадратных блоков C += A * B (n x n, по строкам)
+void local_gemm(const int* A, const int* B, int* C, int n) {
+    local_gemm_mnk(A, n, B, n, C, n, n, n, n);
+}
+
+// Исходное умножение блоков тройным циклом (для сравнения)
+void naive_gemm(const int* A, const int* B, int* C, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < n; k++) {
+                C[i * n + j] += A[i * n + k] * B[k * n + j];
+            }
+        }
+    }
+}
+
+// Сравнение local_gemm с тройным циклом на блоке n x n (на одном процессе)
+void gemm_benchmark(int n) {
+    int* A = (int*)malloc(n * n * sizeof(int));
+    int* B = (int*)malloc(n * n * sizeof(int));
+    int* C_naive = (int*)calloc(n * n, sizeof(int));
+    int* C_packed = (int*)calloc(n * n, sizeof(int));
+    initialize_matrix(A, n, n);
+    initialize_matrix(B, n, n);
+
+    double ops = 2.0 * n * n * n;
+
+    double start_time = MPI_Wtime();
+    naive_gemm(A, B, C_naive, n);
+    double naive_time = MPI_Wtime() - start_time;
+
+    start_time = MPI_Wtime();
+    local_gemm(A, B, C_packed, n);
+    double packed_time = MPI_Wtime() - start_time;
+
+    printf("Block %dx%d\n", n, n);
+    printf("Naive loop:  %f seconds, %f GOP/s\n", naive_time, ops / naive_time / 1e9);
+    printf("Packed GEMM: %f seconds, %f GOP/s\n", packed_time, ops / packed_time / 1e9);
+    printf("Results %s\n", memcmp(C_naive, C_packed, n * n * sizeof(int)) == 0 ? "match" : "DIFFER");
+
+    free(A);
+    free(B);
+    free(C_naive);
+    free(C_packed);
+}
+
+// Тип «блок rows x cols в матрице n_pad x n_pad» с экстентом cols элементов:
+// смещение блока (i, j) решётки pr x pc в Scatterv/Gatherv равно
+// i * rows * pc + j
+MPI_Datatype create_block_type(int n_pad, int rows, int cols) {
+    int sizes[2] = {n_pad, n_pad};
+    int subsizes[2] = {rows, cols};
+    int starts[2] = {0, 0};
+    MPI_Datatype tmp, block_type;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_INT, &tmp);
+    MPI_Type_create_resized(tmp, 0, cols * sizeof(int), &block_type);
+    MPI_Type_commit(&block_type);
+    MPI_Type_free(&tmp);
+    return block_type;
+}
+
+// Смещения блоков для каждого процесса решётки (в единицах block_type)
+void block_displs(int* counts, int* displs, int rows, MPI_Comm grid_comm) {
+    int dims[2], periods[2], c[2];
+    MPI_Cart_get(grid_comm, 2, dims, periods, c);
+    for (int r = 0; r < dims[0] * dims[1]; r++) {
+        MPI_Cart_coords(grid_comm, r, 2, c);
+        counts[r] = 1;
+        displs[r] = c[0] * rows * dims[1] + c[1];
+    }
+}
+
+// Рассылка блоков rows x cols матрицы M (n_pad x n_pad, только на ранге 0 решётки)
+void distribute_blocks(const int* M, int* local, int n_pad, int rows, int cols, MPI_Comm grid_comm) {
+    int size;
+    MPI_Comm_size(grid_comm, &size);
+    int* counts = (int*)malloc(size * sizeof(int));
+    int* displs = (int*)malloc(size * sizeof(int));
+    block_displs(counts, displs, rows, grid_comm);
+    MPI_Datatype block_type = create_block_type(n_pad, rows, cols);
+
+    MPI_Scatterv(M, counts, displs, block_type, local, rows * cols, MPI_INT, 0, grid_comm);
+
+    MPI_Type_free(&block_type);
+    free(counts);
+    free(displs);
+}
+
+// Сбор блоков rows x cols в матрицу M (n_pad x n_pad) на ранге 0 решётки
+void collect_blocks(const int* local, int* M, int n_pad, int rows, int cols, MPI_Comm grid_comm) {
+    int size;
+    MPI_Comm_size(grid_comm, &size);
+    int* counts = (int*)malloc(size * sizeof(int));
+    int* displs = (int*)malloc(size * sizeof(int));
+    block_displs(counts, displs, rows, grid_comm);
+    MPI_Datatype block_type = create_block_type(n_pad, rows, cols);
+
+    MPI_Gatherv(local, rows * cols, MPI_INT, M, counts, displs, block_type, 0, grid_comm);
+
+    MPI_Type_free(&block_type);
+    free(counts);
+    free(displs);
+}
+
+// Запись матрицы n x n (int, по строкам, без дополнения) через MPI-IO:
+// каждый процесс пишет свою часть блока rows x cols, блоки целиком
+// в дополнении пишут ноль элементов
+void write_matrix(const char* filename, const int* local, int rows, int cols, int n, MPI_Comm grid_comm) {
+    int rank, coords[2];
+    MPI_Comm_rank(grid_comm, &rank);
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+    int gi0 = coords[0] * rows, gj0 = coords[1] * cols;
+    int out_rows = n - gi0 < rows ? n - gi0 : rows;
+    int out_cols = n - gj0 < cols ? n - gj0 : cols;
+
+    MPI_File fh;
+    MPI_File_open(grid_comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    MPI_File_set_size(fh, 0);
+    if (out_rows > 0 && out_cols > 0) {
+        int mem_sizes[2] = {rows, cols};
+        int file_sizes[2] = {n, n};
+        int subsizes[2] = {out_rows, out_cols};
+        int mem_starts[2] = {0, 0};
+        int file_starts[2] = {gi0, gj0};
+        MPI_Datatype mem_type, file_type;
+        MPI_Type_create_subarray(2, mem_sizes, subsizes, mem_starts, MPI_ORDER_C, MPI_INT, &mem_type);
+        MPI_Type_create_subarray(2, file_sizes, subsizes, file_starts, MPI_ORDER_C, MPI_INT, &file_type);
+        MPI_Type_commit(&mem_type);
+        MPI_Type_commit(&file_type);
+        MPI_File_set_view(fh, 0, MPI_INT, file_type, "native", MPI_INFO_NULL);
+        MPI_File_write_all(fh, local, 1, mem_type, MPI_STATUS_IGNORE);
+        MPI_Type_free(&mem_type);
+        MPI_Type_free(&file_type);
+    } else {
+        MPI_File_set_view(fh, 0, MPI_INT, MPI_INT, "native", MPI_INFO_NULL);
+        MPI_File_write_all(fh, local, 0, MPI_INT, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&fh);
+}
+
+// Копия матрицы n x n в матрицу n_pad x n_pad, дополненную нулями
+int* pad_matrix(const int* M, int n, int n_pad) {
+    int* P = (int*)calloc((size_t)n_pad * n_pad, sizeof(int));
+    for (int i = 0; i < n; i++) {
+        memcpy(P + (size_t)i * n_pad, M + (size_t)i * n, n * sizeof(int));
+    }
+    return P;
+}
+
+// Обратно: левый верхний угол n x n матрицы n_pad x n_pad
+void unpad_matrix(const int* P, int* M, int n, int n_pad) {
+    for (int i = 0; i < n; i++) {
+        memcpy(M + (size_t)i * n, P + (size_t)i * n_pad, n * sizeof(int));
+    }
+}
+
+// Наименьшее общее кратное (для дополнения n в SUMMA)
+int lcm(int a, int b) {
+    int x = a, y = b;
+    while (y != 0) {
+        int t = x % y;
+        x = y;
+        y = t;
+    }
+    return a / x * b;
+}
+
+// Алгоритм Кэннона на решётке q x q: local_C += сумма по steps шагам
+// local_A * local_B. Начальный сдвиг строки i блоков A (столбца j блоков B)
+// равен i + offset (j + offset): при offset = 0 и steps = q это обычный
+// Кэннон, в 2.5D каждый слой проходит свою часть суммы по k.
+// Блоки уже распределены, содержимое local_A и local_B после вызова
+// не определено.
+void cannon_algorithm(int* local_A, int* local_B, int* local_C, int block_size, int q,
+                      MPI_Comm grid_comm, int offset, int steps, int overlap) {
+    MPI_Comm row_comm, col_comm;
+    int rank, coords[2];
+    MPI_Comm_rank(grid_comm, &rank);
     MPI_Cart_coords(grid_comm, rank, 2, coords);
 
     // Создаём подкоммуникаторы для строк и столбцов
     MPI_Comm_split(grid_comm, coords[0], coords[1], &row_comm);
     MPI_Comm_split(grid_comm, coords[1], coords[0], &col_comm);
 
+    int count = block_size * block_size;
+
+    // Выполняем начальные циклические сдвиги: строка i блоков A сдвигается
+    // влево на i + offset, столбец j блоков B — вверх на j + offset
+    int shift_A = (coords[0] + offset) % q, shift_B = (coords[1] + offset) % q;
+    MPI_Sendrecv_replace(local_A, count, MPI_INT, (coords[1] - shift_A + q) % q, 0,
+                         (coords[1] + shift_A) % q, 0, row_comm, MPI_STATUS_IGNORE);
+
+    MPI_Sendrecv_replace(local_B, count, MPI_INT, (coords[0] - shift_B + q) % q, 0,
+                         (coords[0] + shift_B) % q, 0, col_comm, MPI_STATUS_IGNORE);
+
+    // На каждом шаге A уходит левому соседу, B — верхнему
+    int left = (coords[1] - 1 + q) % q, right = (coords[1] + 1) % q;
+    int up = (coords[0] - 1 + q) % q, down = (coords[0] + 1) % q;
+
+    if (overlap) {
+        // Сдвиг следующих блоков идёт в фоне, пока умножаются текущие.
+        // Приём в отдельные буферы, затем обмен указателями
+        int* own_A = (int*)malloc(count * sizeof(int));
+        int* own_B = (int*)malloc(count * sizeof(int));
+        int* next_A = own_A;
+        int* next_B = own_B;
+        MPI_Request reqs[4];
+
+        for (int step = 0; step < steps; step++) {
+            int last = (step == steps - 1); // после последнего умножения сдвиг не нужен
+            if (!last) {
+                MPI_Irecv(next_A, count, MPI_INT, right, 0, row_comm, &reqs[0]);
+                MPI_Irecv(next_B, count, MPI_INT, down, 0, col_comm, &reqs[1]);
+                MPI_Isend(local_A, count, MPI_INT, left, 0, row_comm, &reqs[2]);
+                MPI_Isend(local_B, count, MPI_INT, up, 0, col_comm, &reqs[3]);
+            }
 
+            local_gemm(local_A, local_B, local_C, block_size);
 
-
-    for (int i = 0; i < sqrt_p; i++) {
-        for (int j = 0; j < sqrt_p; j++) {
-            int target_rank;
-            MPI_Cart_rank(grid_comm, (int[]){i, j}, &target_rank);
-            // printf("i: %d j: %d My rank: %d Target: %d\n", i, j, rank, target_rank);
-            if (target_rank == rank) {
-                for (int bi = 0; bi < block_size; bi++) {
-                    for (int bj = 0; bj < block_size; bj++) {
-                        local_A[bi * block_size + bj] = A[(i * block_size + bi) * n + j * block_size + bj];
-                        local_B[bi * block_size + bj] = B[(i * block_size + bi) * n + j * block_size + bj];
-                    }
-                }
-                break;
+            if (!last) {
+                MPI_Waitall(4, reqs, MPI_STATUSES_IGNORE);
+                int* tmp = local_A; local_A = next_A; next_A = tmp;
+                tmp = local_B; local_B = next_B; next_B = tmp;
             }
         }
+
+        // Освобождаем только свои буферы: буферы вызывающего остаются ему
+        free(own_A);
+        free(own_B);
+    } else {
+        // Основной цикл алгоритма Кэннона
+        for (int step = 0; step < steps; step++) {
+            local_gemm(local_A, local_B, local_C, block_size);
+
+            // Циклический сдвиг блоков
+            MPI_Sendrecv_replace(local_A, count, MPI_INT, left, 0,
+                                 right, 0, row_comm, MPI_STATUS_IGNORE);
+
+            MPI_Sendrecv_replace(local_B, count, MPI_INT, up, 0,
+                                 down, 0, col_comm, MPI_STATUS_IGNORE);
+        }
     }
 
-    // Выполняем начальные циклические сдвиги
-    MPI_Sendrecv_replace(local_A, block_size * block_size, MPI_INT, (coords[0] - coords[1] + sqrt_p) % sqrt_p, 0,
-                         (coords[0] + coords[1]) % sqrt_p, 0, row_comm, MPI_STATUS_IGNORE);
 
-    MPI_Sendrecv_replace(local_B, block_size * block_size, MPI_INT, (coords[1] - coords[0] + sqrt_p) % sqrt_p, 0,
-                         (coords[1] + coords[0]) % sqrt_p, 0, col_comm, MPI_STATUS_IGNORE);
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+}
+
+// SUMMA на решётке pr x pc: у каждого процесса блоки A, B и C размером
+// rows x cols. Сумма по k идёт панелями ширины до kb: владелец столбца
+// панели A рассылает её по row_comm, владелец строки панели B — по col_comm.
+// Панель обрезается на границе блока, чтобы не разрываться между
+// владельцами. Рассылка следующей панели (Ibcast) идёт, пока умножается текущая.
+void summa_algorithm(const int* local_A, const int* local_B, int* local_C, int rows, int cols,
+                     int n_pad, int kb, MPI_Comm grid_comm) {
+    MPI_Comm row_comm, col_comm;
+    int rank, coords[2];
+    MPI_Comm_rank(grid_comm, &rank);
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+
+    MPI_Comm_split(grid_comm, coords[0], coords[1], &row_comm);
+    MPI_Comm_split(grid_comm, coords[1], coords[0], &col_comm);
 
-    // Основной цикл алгоритма Кэннона
-    for (int step = 0; step < sqrt_p; step++) {
-        for (int i = 0; i < block_size; i++) {
-            for (int j = 0; j < block_size; j++) {
-                for (int k = 0; k < block_size; k++) {
-                    local_C[i * block_size + j] += local_A[i * block_size + k] * local_B[k * block_size + j];
+    int* panel_A[2];
+    int* panel_B[2];
+    for (int b = 0; b < 2; b++) {
+        panel_A[b] = (int*)malloc(rows * kb * sizeof(int));
+        panel_B[b] = (int*)malloc(kb * cols * sizeof(int));
+    }
+    MPI_Request reqs[2];
+    int widths[2];
+    int k0 = 0;
+
+    for (int s = 0; ; s++) {
+        // Рассылка панели s (если есть) в буфер s % 2
+        int w = 0;
+        if (k0 < n_pad) {
+            int owner_col = k0 / cols, owner_row = k0 / rows;
+            int* pa = panel_A[s % 2];
+            int* pb = panel_B[s % 2];
+            w = kb;
+            if (w > cols - k0 % cols) {
+                w = cols - k0 % cols;
+            }
+            if (w > rows - k0 % rows) {
+                w = rows - k0 % rows;
+            }
+            if (coords[1] == owner_col) {
+                for (int i = 0; i < rows; i++) {
+                    memcpy(pa + i * w, local_A + i * cols + k0 % cols, w * sizeof(int));
                 }
             }
+            if (coords[0] == owner_row) {
+                memcpy(pb, local_B + (k0 % rows) * cols, w * cols * sizeof(int));
+            }
+            MPI_Ibcast(pa, rows * w, MPI_INT, owner_col, row_comm, &reqs[0]);
+            MPI_Ibcast(pb, w * cols, MPI_INT, owner_row, col_comm, &reqs[1]);
+            widths[s % 2] = w;
+            k0 += w;
         }
 
-        // Циклический сдвиг блоков
-        MPI_Sendrecv_replace(local_A, block_size * block_size, MPI_INT, (coords[1] + 1) % sqrt_p, 0,
-                             (coords[1] - 1 + sqrt_p) % sqrt_p, 0, row_comm, MPI_STATUS_IGNORE);
+        // Умножение панели s - 1, пока идёт рассылка панели s
+        if (s > 0) {
+            int b = (s - 1) % 2;
+            local_gemm_mnk(panel_A[b], widths[b], panel_B[b], cols, local_C, cols, rows, cols, widths[b]);
+        }
+
+        if (w == 0) {
+            break;
+        }
+        MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE);
+    }
+
+    for (int b = 0; b < 2; b++) {
+        free(panel_A[b]);
+        free(panel_B[b]);
+    }
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+}
+
+// Время одного запуска алгоритма умножения
+typedef struct {
+    double compute_time; // Само умножение с обменами между процессами
+    double total_time;   // Вместе с раздачей блоков и сбором C
+} mm_times_t;
+
+// Кэннон на sqrt(p) x sqrt(p) процессах. A и B (n x n) нужны только
+// на ранге 0, туда же собирается C.
+mm_times_t run_cannon(const int* A, const int* B, int* C, int n, int overlap, const char* output) {
+    int size, rank;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int q = (int)sqrt(size);
+
+    // Если n не делится на q, матрицы дополняются нулями до n_pad
+    int block_size = (n + q - 1) / q;
+    int n_pad = block_size * q;
+
+    // Декартова решётка без перенумерации: ранг 0 решётки — корневой процесс
+    MPI_Comm grid_comm;
+    int dims[2] = {q, q};
+    int periods[2] = {1, 1}; // Замкнутая топология (циклический сдвиг)
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid_comm);
 
-        MPI_Sendrecv_replace(local_B, block_size * block_size, MPI_INT, (coords[0] + 1) % sqrt_p, 0,
-                             (coords[0] - 1 + sqrt_p) % sqrt_p, 0, col_comm, MPI_STATUS_IGNORE);
+    int* A_pad = NULL;
+    int* B_pad = NULL;
+    int* C_pad = NULL;
+    if (rank == 0) {
+        A_pad = pad_matrix(A, n, n_pad);
+        B_pad = pad_matrix(B, n, n_pad);
+        C_pad = (int*)malloc((size_t)n_pad * n_pad * sizeof(int));
     }
 
+    int* local_A = (int*)malloc(block_size * block_size * sizeof(int));
+    int* local_B = (int*)malloc(block_size * block_size * sizeof(int));
+    int* local_C = (int*)calloc(block_size * block_size, sizeof(int));
+
+    mm_times_t t;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    distribute_blocks(A_pad, local_A, n_pad, block_size, block_size, grid_comm);
+    distribute_blocks(B_pad, local_B, n_pad, block_size, block_size, grid_comm);
+
+    double compute_start = MPI_Wtime();
+    cannon_algorithm(local_A, local_B, local_C, block_size, q, grid_comm, 0, q, overlap);
+    t.compute_time = MPI_Wtime() - compute_start;
+
+    collect_blocks(local_C, C_pad, n_pad, block_size, block_size, grid_comm);
+    t.total_time = MPI_Wtime() - start_time;
+
+    if (output != NULL) {
+        write_matrix(output, local_C, block_size, block_size, n, grid_comm);
+    }
 
     if (rank == 0) {
-        for (int i = 0; i < sqrt_p; i++) {
-            for (int j = 0; j < sqrt_p; j++) {
-                int source_rank;
-                MPI_Cart_rank(grid_comm, (int[]){i, j}, &source_rank);
-                if (source_rank != 0) {
-                    MPI_Recv(local_C, block_size * block_size, MPI_INT, source_rank, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                }
-                for (int bi = 0; bi < block_size; bi++) {
-                    for (int bj = 0; bj < block_size; bj++) {
-                        C[(i * block_size + bi) * n + j * block_size + bj] = local_C[bi * block_size + bj];
-                    }
-                }
-            }
-        }
-    } else {
-        MPI_Send(local_C, block_size * block_size, MPI_INT, 0, 0, MPI_COMM_WORLD);
+        unpad_matrix(C_pad, C, n, n_pad);
+        free(A_pad);
+        free(B_pad);
+        free(C_pad);
+    }
+    free(local_A);
+    free(local_B);
+    free(local_C);
+    MPI_Comm_free(&grid_comm);
+    return t;
+}
+
+// SUMMA на любом числе процессов: решётка pr x pc из MPI_Dims_create
+mm_times_t run_summa(const int* A, const int* B, int* C, int n, const char* output) {
+    int size, rank;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    MPI_Comm grid_comm;
+    int dims[2] = {0, 0};
+    int periods[2] = {0, 0};
+    MPI_Dims_create(size, 2, dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid_comm);
+
+    // n дополняется до кратного pr и pc; панели до SUMMA_KB столбцов,
+    // на границах блоков короче
+    int l = lcm(dims[0], dims[1]);
+    int n_pad = (n + l - 1) / l * l;
+    int rows = n_pad / dims[0], cols = n_pad / dims[1];
+    int kb = SUMMA_KB;
+
+    int* A_pad = NULL;
+    int* B_pad = NULL;
+    int* C_pad = NULL;
+    if (rank == 0) {
+        A_pad = pad_matrix(A, n, n_pad);
+        B_pad = pad_matrix(B, n, n_pad);
+        C_pad = (int*)malloc((size_t)n_pad * n_pad * sizeof(int));
+    }
+
+    int* local_A = (int*)malloc(rows * cols * sizeof(int));
+    int* local_B = (int*)malloc(rows * cols * sizeof(int));
+    int* local_C = (int*)calloc(rows * cols, sizeof(int));
+
+    mm_times_t t;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    distribute_blocks(A_pad, local_A, n_pad, rows, cols, grid_comm);
+    distribute_blocks(B_pad, local_B, n_pad, rows, cols, grid_comm);
+
+    double compute_start = MPI_Wtime();
+    summa_algorithm(local_A, local_B, local_C, rows, cols, n_pad, kb, grid_comm);
+    t.compute_time = MPI_Wtime() - compute_start;
+
+    collect_blocks(local_C, C_pad, n_pad, rows, cols, grid_comm);
+    t.total_time = MPI_Wtime() - start_time;
+
+    if (output != NULL) {
+        write_matrix(output, local_C, rows, cols, n, grid_comm);
     }
 
+    if (rank == 0) {
+        printf("SUMMA grid %dx%d, panel %d\n", dims[0], dims[1], kb);
+        unpad_matrix(C_pad, C, n, n_pad);
+        free(A_pad);
+        free(B_pad);
+        free(C_pad);
+    }
     free(local_A);
     free(local_B);
     free(local_C);
     MPI_Comm_free(&grid_comm);
-    MPI_Comm_free(&row_comm);
-    MPI_Comm_free(&col_comm);
+    return t;
+}
+
+// Подходит ли число слоёв c для 2.5D: p = q * q * c и q делится на c
+int valid_layers(int size, int c) {
+    if (c < 1 || size % c != 0) {
+        return 0;
+    }
+    int q = (int)sqrt(size / c);
+    return q * q * c == size && q % c == 0;
+}
+
+// Наибольшее подходящее число слоёв (1 — обычный Кэннон)
+int choose_layers(int size) {
+    int best = 1;
+    for (int c = 2; c * c * c <= size; c++) {
+        if (valid_layers(size, c)) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+// 2.5D на решётке q x q x c: слой 0 получает блоки как в Кэнноне и рассылает
+// их остальным слоям (память в c раз больше), каждый слой делает q / c шагов
+// Кэннона со своим сдвигом, затем C суммируется по слоям в слой 0.
+// Объём сдвигов на процесс падает в c раз.
+mm_times_t run_25d(const int* A, const int* B, int* C, int n, int c, const char* output) {
+    int size, rank;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int q = (int)sqrt(size / c);
+
+    int block_size = (n + q - 1) / q;
+    int n_pad = block_size * q;
+
+    // Ранг = (i * q + j) * c + layer, ранг 0 — процесс (0, 0) слоя 0
+    MPI_Comm cube_comm, layer_comm, depth_comm;
+    int dims[3] = {q, q, c};
+    int periods[3] = {1, 1, 0};
+    int coords[3];
+    MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 0, &cube_comm);
+    MPI_Cart_coords(cube_comm, rank, 3, coords);
+    MPI_Cart_sub(cube_comm, (int[]){1, 1, 0}, &layer_comm);
+    MPI_Cart_sub(cube_comm, (int[]){0, 0, 1}, &depth_comm);
+    int layer = coords[2];
+
+    int* A_pad = NULL;
+    int* B_pad = NULL;
+    int* C_pad = NULL;
+    if (rank == 0) {
+        A_pad = pad_matrix(A, n, n_pad);
+        B_pad = pad_matrix(B, n, n_pad);
+        C_pad = (int*)malloc((size_t)n_pad * n_pad * sizeof(int));
+    }
+
+    int count = block_size * block_size;
+    int* local_A = (int*)malloc(count * sizeof(int));
+    int* local_B = (int*)malloc(count * sizeof(int));
+    int* local_C = (int*)calloc(count, sizeof(int));
+
+    mm_times_t t;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    if (layer == 0) {
+        distribute_blocks(A_pad, local_A, n_pad, block_size, block_size, layer_comm);
+        distribute_blocks(B_pad, local_B, n_pad, block_size, block_size, layer_comm);
+    }
+
+    double compute_start = MPI_Wtime();
+    MPI_Bcast(local_A, count, MPI_INT, 0, depth_comm);
+    MPI_Bcast(local_B, count, MPI_INT, 0, depth_comm);
+    cannon_algorithm(local_A, local_B, local_C, block_size, q, layer_comm, layer * (q / c), q / c, 1);
+    MPI_Reduce(layer == 0 ? MPI_IN_PLACE : local_C, local_C, count, MPI_INT, MPI_SUM, 0, depth_comm);
+    t.compute_time = MPI_Wtime() - compute_start;
+
+    if (layer == 0) {
+        collect_blocks(local_C, C_pad, n_pad, block_size, block_size, layer_comm);
+    }
+    t.total_time = MPI_Wtime() - start_time;
+
+    if (output != NULL && layer == 0) {
+        write_matrix(output, local_C, block_size, block_size, n, layer_comm);
+    }
+
+    if (rank == 0) {
+        printf("2.5D grid %dx%dx%d\n", q, q, c);
+        unpad_matrix(C_pad, C, n, n_pad);
+        free(A_pad);
+        free(B_pad);
+        free(C_pad);
+    }
+    free(local_A);
+    free(local_B);
+    free(local_C);
+    MPI_Comm_free(&layer_comm);
+    MPI_Comm_free(&depth_comm);
+    MPI_Comm_free(&cube_comm);
+    return t;
+}
+
+void print_times(const char* name, mm_times_t t, int n) {
+    printf("%-8s compute %f s (%f GOP/s), total %f s\n", name, t.compute_time,
+           2.0 * n * n * n / t.compute_time / 1e9, t.total_time);
 }
 
 int main(int argc, char** argv) {
@@ -134,50 +714,121 @@ int main(int argc, char** argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+    // mpirun -n 1 ./2 gemm [n] — сравнение локального умножения блоков
+    if (argc > 1 && strcmp(argv[1], "gemm") == 0) {
+        if (rank == 0) {
+            gemm_benchmark(argc > 2 ? atoi(argv[2]) : 512);
+        }
+        MPI_Finalize();
+        return 0;
+    }
+
+    // mpirun -n p ./2 [cannon|overlap|summa|2.5d|bench] [n] [output_file|-] [c]
+    // overlap — Кэннон со сдвигами блоков на фоне умножения, summa работает
+    // на любом p, 2.5d — на p = q * q * c (c слоёв, q делится на c),
+    // bench запускает все подходящие алгоритмы на одних данных и сверяет C
+    const char* algo = argc > 1 ? argv[1] : "cannon";
+    int n = argc > 2 ? atoi(argv[2]) : 4; // Размерность матриц
+    const char* output = argc > 3 && strcmp(argv[3], "-") != 0 ? argv[3] : NULL; // Файл для C (MPI-IO)
+    int c = argc > 4 ? atoi(argv[4]) : choose_layers(size); // Число слоёв 2.5D
+
+    int is_cannon = strcmp(algo, "cannon") == 0 || strcmp(algo, "overlap") == 0;
+    int bench = (strcmp(algo, "bench") == 0);
+    if (!is_cannon && !bench && strcmp(algo, "summa") != 0 && strcmp(algo, "2.5d") != 0) {
+        if (rank == 0) {
+            printf("Usage: %s [cannon|overlap|summa|2.5d|bench|gemm] [n] [output_file|-] [c]\n", argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
     int sqrt_p = (int)sqrt(size);
-    if (sqrt_p * sqrt_p != size) {
+    int square = (sqrt_p * sqrt_p == size);
+    if (!square && is_cannon) {
         if (rank == 0) {
             printf("The number of processes must be a perfect square.\n");
         }
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    if (!valid_layers(size, c) && strcmp(algo, "2.5d") == 0) {
+        if (rank == 0) {
+            printf("2.5D needs p = q * q * c with q divisible by c.\n");
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-    int n = 4; // Размерность матриц (например, 4x4)
-    int* A = (int*)malloc(n * n * sizeof(int));
-    int* B = (int*)malloc(n * n * sizeof(int));
+    int* A = NULL;
+    int* B = NULL;
     int* C = NULL;
+    int* C_ref = NULL;
 
     if (rank == 0) {
-        C = (int*)calloc(n * n, sizeof(int));
+        A = (int*)malloc((size_t)n * n * sizeof(int));
+        B = (int*)malloc((size_t)n * n * sizeof(int));
+        C = (int*)malloc((size_t)n * n * sizeof(int));
 
         initialize_matrix(A, n, n);
         initialize_matrix(B, n, n);
 
-        printf("Matrix A:\n");
-        print_matrix(A, n, n);
+        if (n <= PRINT_MAX) {
+            printf("Matrix A:\n");
+            print_matrix(A, n, n);
 
-        printf("Matrix B:\n");
-        print_matrix(B, n, n);
+            printf("Matrix B:\n");
+            print_matrix(B, n, n);
+        }
     }
 
-    MPI_Bcast(A, n*n, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(B, n*n, MPI_INT, 0, MPI_COMM_WORLD);
+    if (bench) {
+        // Эталон — SUMMA (работает на любом p), остальные сверяются с ним
+        if (rank == 0) {
+            printf("Processes: %d, n = %d\n", size, n);
+            C_ref = (int*)malloc((size_t)n * n * sizeof(int));
+        }
+        mm_times_t t = run_summa(A, B, C_ref, n, NULL);
+        if (rank == 0) {
+            print_times("summa", t, n);
+        }
+        const char* names[3] = {"cannon", "overlap", "2.5d"};
+        for (int a = 0; a < 3; a++) {
+            if (a < 2 && !square) {
+                continue;
+            }
+            if (a == 2 && !valid_layers(size, c)) {
+                continue;
+            }
+            t = a < 2 ? run_cannon(A, B, C, n, a == 1, NULL) : run_25d(A, B, C, n, c, NULL);
+            if (rank == 0) {
+                print_times(names[a], t, n);
+                printf("Results %s\n", memcmp(C, C_ref, (size_t)n * n * sizeof(int)) == 0 ? "match" : "DIFFER");
+            }
+        }
+    } else {
+        mm_times_t t;
+        if (strcmp(algo, "summa") == 0) {
+            t = run_summa(A, B, C, n, output);
+        } else if (strcmp(algo, "2.5d") == 0) {
+            t = run_25d(A, B, C, n, c, output);
+        } else {
+            t = run_cannon(A, B, C, n, strcmp(algo, "overlap") == 0, output);
+        }
 
-    double start_time = MPI_Wtime();
-    cannon_algorithm(A, B, C, n, sqrt_p, rank);
-    double end_time = MPI_Wtime();
+        if (rank == 0) {
+            if (n <= PRINT_MAX) {
+                printf("Matrix C (Result):\n");
+                print_matrix(C, n, n);
+            }
+            print_times(algo, t, n);
+        }
+    }
 
     if (rank == 0) {
-        printf("Matrix C (Result):\n");
-        print_matrix(C, n, n);
-
-        printf("Elapsed time: %f seconds\n", end_time - start_time);
-
         free(A);
         free(B);
         free(C);
+        free(C_ref);
     }
 
     MPI_Finalize();
     return 0;
-}
\ No newline at end of file
+}
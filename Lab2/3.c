@@ -1,29 +1,68 @@
 #include <mpi.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #define TOLERANCE 1e-6  // Заданная точность
 #define MAX_ITER 10000  // Максимальное число итераций
+#define TILE_STEPS 4  // Итераций между обменами в режиме временной блокировки
+#define STENCIL_FLOPS 6  // Операций с плавающей точкой на обновление точки
+#define STENCIL_BYTES 16  // Номинальный трафик на обновление: чтение старого и запись нового значения
+#define MG_PRE 2  // Сглаживающих итераций до спуска на грубую сетку
+#define MG_POST 2  // Сглаживающих итераций после коррекции
+#define MG_COARSE_ITER 1000  // Предел итераций на самой грубой сетке
 
 // Функция источника тепла f(x, y)
 double f(double x, double y) {
     return 0.0; // Задаётся пользователем, здесь пример с f(x, y) = 0
 }
 
-// Инициализация пластинки
-void initialize_plate(double* plate, int nx, int ny, double boundary_value) {
-    for (int i = 0; i < nx; i++) {
-        for (int j = 0; j < ny; j++) {
-            if (i == 0 || i == nx - 1 || j == 0 || j == ny - 1) {
-                plate[i * ny + j] = boundary_value; // Границы
+// Инициализация блока пластинки rows x ld по глобальным координатам:
+// локальная точка (i, j) — глобальная (gi0 + i, gj0 + j). Каждый процесс
+// строит только свой блок, без общей пластинки на процессе 0.
+void initialize_block(double* block, int rows, int ld, int gi0, int gj0, int nx, int ny, double boundary_value) {
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < ld; j++) {
+            int gi = gi0 + i, gj = gj0 + j;
+            if (gi == 0 || gi == nx - 1 || gj == 0 || gj == ny - 1) {
+                block[i * ld + j] = boundary_value; // Границы
             } else {
-                plate[i * ny + j] = 0.0; // Внутренние точки
+                block[i * ld + j] = 0.0; // Внутренние точки
             }
         }
     }
 }
 
+// Коллективная запись поля в один двоичный файл (nx x ny значений double по
+// строкам) через MPI-IO. Процесс пишет прямоугольник [i0, i1) x [j0, j1) своего
+// блока (local_rows строк с шагом ld), (gi0, gj0) — глобальные координаты
+// локальной точки (0, 0). Прямоугольники процессов не должны пересекаться.
+void write_plate(const char* filename, const double* block, int local_rows, int ld,
+                 int i0, int i1, int j0, int j1, int gi0, int gj0, int nx, int ny, MPI_Comm comm) {
+    int mem_sizes[2] = {local_rows, ld};
+    int file_sizes[2] = {nx, ny};
+    int subsizes[2] = {i1 - i0, j1 - j0};
+    int mem_starts[2] = {i0, j0};
+    int file_starts[2] = {gi0 + i0, gj0 + j0};
+    MPI_Datatype mem_type, file_type;
+    MPI_Type_create_subarray(2, mem_sizes, subsizes, mem_starts, MPI_ORDER_C, MPI_DOUBLE, &mem_type);
+    MPI_Type_create_subarray(2, file_sizes, subsizes, file_starts, MPI_ORDER_C, MPI_DOUBLE, &file_type);
+    MPI_Type_commit(&mem_type);
+    MPI_Type_commit(&file_type);
+
+    MPI_File fh;
+    MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    MPI_File_set_size(fh, 0);
+    MPI_File_set_view(fh, 0, MPI_DOUBLE, file_type, "native", MPI_INFO_NULL);
+    MPI_File_write_all(fh, block, 1, mem_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+
+    MPI_Type_free(&mem_type);
+    MPI_Type_free(&file_type);
+}
+
 // Печать области
 void print_plate(double* plate, int nx, int ny) {
     for (int i = 0; i < nx; i++) {
@@ -34,109 +73,708 @@ void print_plate(double* plate, int nx, int ny) {
     }
 }
 
-// Метод Гаусса-Зейделя с волновой схемой
-void gauss_seidel_wave(double* local_plate, int nx, int ny, int rank, int size, double boundary_value) {
-    int local_nx = nx / size + 2; // С учётом соседних строк
+// Итерация Якоби в точке (i, j), строка i — глобальная gi0 + i. Возвращает |dst - src|.
+double jacobi_point(const double* src, double* dst, int i, int j, int gi0, int nx, int ny) {
+    dst[i * ny + j] = 0.25 * (
+        src[(i - 1) * ny + j] +
+        src[(i + 1) * ny + j] +
+        src[i * ny + j - 1] +
+        src[i * ny + j + 1] -
+        f((double)(gi0 + i) / nx, (double)j / ny));
+    return fabs(dst[i * ny + j] - src[i * ny + j]);
+}
+
+// Одна итерация Якоби для строки i: dst = stencil(src). Возвращает сумму |dst - src|.
+// Строка i буфера — глобальная строка gi0 + i (нужно только для f).
+double jacobi_row(const double* src, double* dst, int i, int gi0, int nx, int ny) {
+    double diff = 0.0;
+
+    for (int j = 1; j < ny - 1; j++) {
+        diff += jacobi_point(src, dst, i, j, gi0, nx, ny);
+    }
+
+    return diff;
+}
+
+// Метод Гаусса-Зейделя с волновой схемой (итерации Якоби по полосам строк).
+// Сначала считаются крайние собственные строки, затем их обмен с соседями
+// запускается неблокирующими MPI_Isend/MPI_Irecv, и пока строки в пути,
+// считаются внутренние строки. Сумма изменений сводится неблокирующим
+// MPI_Iallreduce и проверяется на следующей итерации, поэтому после
+// достижения точности выполняется одна лишняя итерация.
+// В гибридном режиме строки делят потоки OpenMP: крайние строки считаются
+// всеми потоками по столбцам, затем главный поток запускает обмен (MPI
+// вызывается только из него, MPI_THREAD_FUNNELED) и вместе с остальными
+// считает внутренние строки.
+// local_plate — rows собственных строк и по одной соседней, строка 0 — глобальная gi0.
+// Возвращает число итераций.
+int gauss_seidel_wave(double* local_plate, int rows, int gi0, int nx, int ny, int rank, int size,
+                      double boundary_value) {
+    int local_nx = rows + 2; // С учётом соседних строк
     int local_ny = ny;
+    int up = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int down = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
 
+    // Два буфера меняются ролями каждую итерацию; границы есть в обоих
+    double* old_plate = local_plate;
     double* new_plate = (double*)malloc(local_nx * local_ny * sizeof(double));
-    double global_diff;
+    for (int i = 0; i < local_nx * local_ny; i++) {
+        new_plate[i] = local_plate[i];
+    }
+
+    MPI_Request halo[4];
+    MPI_Request diff_request = MPI_REQUEST_NULL;
+    double local_diff = 0.0;
+    double global_diff = 0.0;
+    int converged = 0;
 
     int iter = 0;
     do {
-        global_diff = 0.0;
+        double diff = 0.0;
 
-        for (int i = 1; i < local_nx - 1; i++) {
+        #pragma omp parallel reduction(+:diff)
+        {
+            // Крайние строки — их ждут соседи
+            #pragma omp for schedule(static)
             for (int j = 1; j < local_ny - 1; j++) {
-                double old_value = local_plate[i * local_ny + j];
-                new_plate[i * local_ny + j] = 0.25 * (
-                    local_plate[(i - 1) * local_ny + j] +
-                    local_plate[(i + 1) * local_ny + j] +
-                    local_plate[i * local_ny + j - 1] +
-                    local_plate[i * local_ny + j + 1] -
-                    f((double)i / nx, (double)j / ny));
-                global_diff += fabs(new_plate[i * local_ny + j] - old_value);
+                diff += jacobi_point(old_plate, new_plate, 1, j, gi0, nx, local_ny);
+                if (local_nx - 2 > 1) {
+                    diff += jacobi_point(old_plate, new_plate, local_nx - 2, j, gi0, nx, local_ny);
+                }
+            }
+
+            // Обмен граничными данными между процессами
+            #pragma omp master
+            {
+                MPI_Irecv(new_plate, local_ny, MPI_DOUBLE, up, 0, MPI_COMM_WORLD, &halo[0]);
+                MPI_Irecv(new_plate + (local_nx - 1) * local_ny, local_ny, MPI_DOUBLE, down, 1, MPI_COMM_WORLD, &halo[1]);
+                MPI_Isend(new_plate + local_ny, local_ny, MPI_DOUBLE, up, 1, MPI_COMM_WORLD, &halo[2]);
+                MPI_Isend(new_plate + (local_nx - 2) * local_ny, local_ny, MPI_DOUBLE, down, 0, MPI_COMM_WORLD, &halo[3]);
             }
+
+            // Внутренние строки, пока идёт обмен
+            #pragma omp for schedule(static)
+            for (int i = 2; i < local_nx - 2; i++) {
+                diff += jacobi_row(old_plate, new_plate, i, gi0, nx, local_ny);
+            }
+        }
+
+        // Сравнение разницы на всех процессах: результат предыдущей итерации
+        if (iter > 0) {
+            MPI_Wait(&diff_request, MPI_STATUS_IGNORE);
+            converged = global_diff <= TOLERANCE;
+        }
+
+        MPI_Waitall(4, halo, MPI_STATUSES_IGNORE);
+
+        double* tmp = old_plate;
+        old_plate = new_plate;
+        new_plate = tmp;
+
+        local_diff = diff;
+        MPI_Iallreduce(&local_diff, &global_diff, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, &diff_request);
+
+        iter++;
+    } while (!converged && iter < MAX_ITER);
+
+    MPI_Wait(&diff_request, MPI_STATUS_IGNORE);
+
+    // Последнее состояние должно оказаться в local_plate
+    if (old_plate != local_plate) {
+        for (int i = 0; i < local_nx * local_ny; i++) {
+            local_plate[i] = old_plate[i];
         }
+        new_plate = old_plate;
+    }
+
+    free(new_plate);
+    return iter;
+}
+
+// Та же итерационная схема (Якоби с обменом граничными строками), но с
+// временной блокировкой. Процесс хранит steps соседних строк с каждой стороны,
+// обменивается ими раз в steps итераций и выполняет steps итераций подряд:
+// итерация s допустима на строках [1 + s, ext_nx - 1 - s). Внутри процесса
+// итерации идут волной по строкам: на позиции w итерация s обновляет строку
+// w - s, так что рабочий набор — около steps + 2 строк в двух буферах, и он
+// остаётся в кэше, вместо steps полных проходов по памяти.
+// Возвращает число итераций.
+int gauss_seidel_wave_tiled(double* local_plate, int rows, int gi0, int nx, int ny, int rank, int size, int steps) {
+    int h = steps;        // Глубина соседних строк
+    int ext_nx = rows + 2 * h;
+    int up = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int down = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
 
-        // Обмен граничными данными между процессами
-        if (rank > 0) {
-            MPI_Send(new_plate + local_ny, local_ny, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD);
-            MPI_Recv(new_plate, local_ny, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    int min_rows;
+    MPI_Allreduce(&rows, &min_rows, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (min_rows < h) {
+        if (rank == 0) {
+            printf("Each process needs at least %d rows for %d steps per exchange.\n", h, steps);
         }
-        if (rank < size - 1) {
-            MPI_Send(new_plate + (local_nx - 2) * local_ny, local_ny, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD);
-            MPI_Recv(new_plate + (local_nx - 1) * local_ny, local_ny, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Строка k local_plate соответствует строке k + h - 1 буфера
+    double* buf[2];
+    buf[0] = (double*)calloc(ext_nx * ny, sizeof(double));
+    buf[1] = (double*)calloc(ext_nx * ny, sizeof(double));
+    for (int k = 0; k < rows + 2; k++) {
+        for (int j = 0; j < ny; j++) {
+            buf[0][(k + h - 1) * ny + j] = local_plate[k * ny + j];
+            buf[1][(k + h - 1) * ny + j] = local_plate[k * ny + j];
         }
+    }
+
+    // Границы пластинки (крайние строки первого и последнего процессов) не обновляются
+    int lo0 = rank > 0 ? 1 : h;
+    int hi0 = rank < size - 1 ? ext_nx - 1 : h + rows;
 
-        // Сравнение разницы на всех процессах
-        double local_diff = global_diff;
+    double global_diff;
+    int iter = 0;
+    do {
+        // Обмен h граничными строками
+        MPI_Sendrecv(buf[0] + h * ny, h * ny, MPI_DOUBLE, up, 0,
+                     buf[0] + (h + rows) * ny, h * ny, MPI_DOUBLE, down, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(buf[0] + rows * ny, h * ny, MPI_DOUBLE, down, 1,
+                     buf[0], h * ny, MPI_DOUBLE, up, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+        // Граничные столбцы принятых строк нужны и во втором буфере
+        for (int k = 0; k < ext_nx; k++) {
+            if (k < h || k >= h + rows) {
+                buf[1][k * ny] = buf[0][k * ny];
+                buf[1][k * ny + ny - 1] = buf[0][k * ny + ny - 1];
+            }
+        }
+
+        // Волна: итерация s читает buf[s % 2] и пишет buf[(s + 1) % 2]
+        double local_diff = 0.0;
+        for (int w = lo0; w < hi0 + steps - 1; w++) {
+            for (int s = 0; s < steps; s++) {
+                int i = w - s;
+                int lo = rank > 0 ? lo0 + s : lo0;
+                int hi = rank < size - 1 ? hi0 - s : hi0;
+                if (i < lo || i >= hi) {
+                    continue;
+                }
+                double diff = jacobi_row(buf[s % 2], buf[(s + 1) % 2], i, gi0 - (h - 1), nx, ny);
+                if (s == steps - 1 && i >= h && i < h + rows) {
+                    local_diff += diff;
+                }
+            }
+        }
+        if (steps % 2 == 1) {
+            double* tmp = buf[0];
+            buf[0] = buf[1];
+            buf[1] = tmp;
+        }
+
+        // Сравнение разницы на всех процессах (раз в steps итераций)
         MPI_Allreduce(&local_diff, &global_diff, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
 
-        // Копирование нового состояния в старое
-        for (int i = 1; i < local_nx - 1; i++) {
-            for (int j = 1; j < local_ny; j++) {
-                local_plate[i * local_ny + j] = new_plate[i * local_ny + j];
+        iter += steps;
+    } while (global_diff > TOLERANCE && iter < MAX_ITER);
+
+    for (int k = 1; k <= rows; k++) {
+        for (int j = 0; j < ny; j++) {
+            local_plate[k * ny + j] = buf[0][(k + h - 1) * ny + j];
+        }
+    }
+
+    free(buf[0]);
+    free(buf[1]);
+    return iter;
+}
+
+// Уровень распределённой многосеточной иерархии. Каждый процесс хранит свою
+// полосу внутренних строк [lo, hi) и по одной соседней строке сверху и снизу:
+// локальная строка k соответствует глобальной строке lo - 1 + k.
+typedef struct {
+    int nx, ny;  // Глобальный размер уровня (точек, включая границы)
+    int lo, hi;  // Собственные внутренние строки
+    int rows;    // hi - lo
+    double* u;   // Решение (на грубых уровнях — поправка)
+    double* f;   // Правая часть
+    double* r;   // Невязка
+} mg_level_t;
+
+// Разбиение n внутренних строк (начиная с 1) на size почти равных полос
+void row_range(int n, int rank, int size, int* lo, int* hi) {
+    *lo = 1 + rank * (n / size) + (rank < n % size ? rank : n % size);
+    *hi = *lo + n / size + (rank < n % size ? 1 : 0);
+}
+
+// Обмен соседними строками с процессами rank-1 и rank+1
+void exchange_rows(double* a, int rows, int ny, int rank, int size) {
+    int up = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int down = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
+
+    MPI_Sendrecv(a + ny, ny, MPI_DOUBLE, up, 0,
+                 a + (rows + 1) * ny, ny, MPI_DOUBLE, down, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(a + rows * ny, ny, MPI_DOUBLE, down, 1,
+                 a, ny, MPI_DOUBLE, up, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+// Красно-чёрная итерация Гаусса-Зейделя на уровне. Цвет точки определяется
+// по глобальным координатам, поэтому результат не зависит от числа процессов.
+// Возвращает локальное максимальное изменение.
+double mg_smooth(mg_level_t* g, int rank, int size) {
+    int ny = g->ny;
+    double max_diff = 0.0;
+
+    for (int color = 0; color < 2; color++) {
+        exchange_rows(g->u, g->rows, ny, rank, size);
+        for (int k = 1; k <= g->rows; k++) {
+            int gi = g->lo - 1 + k;
+            for (int j = 1 + (gi + color + 1) % 2; j < ny - 1; j += 2) {
+                double old_value = g->u[k * ny + j];
+                g->u[k * ny + j] = 0.25 * (
+                    g->u[(k - 1) * ny + j] +
+                    g->u[(k + 1) * ny + j] +
+                    g->u[k * ny + j - 1] +
+                    g->u[k * ny + j + 1] -
+                    g->f[k * ny + j]);
+                double diff = fabs(g->u[k * ny + j] - old_value);
+                if (diff > max_diff) {
+                    max_diff = diff;
+                }
+            }
+        }
+    }
+
+    return max_diff;
+}
+
+// Невязка r = f - (сумма соседей - 4u) в собственных точках.
+// Возвращает локальный max |r|.
+double mg_residual(mg_level_t* g, int rank, int size) {
+    int ny = g->ny;
+    double max_r = 0.0;
+
+    exchange_rows(g->u, g->rows, ny, rank, size);
+    for (int k = 1; k <= g->rows; k++) {
+        for (int j = 1; j < ny - 1; j++) {
+            double res = g->f[k * ny + j] - (
+                g->u[(k - 1) * ny + j] +
+                g->u[(k + 1) * ny + j] +
+                g->u[k * ny + j - 1] +
+                g->u[k * ny + j + 1] -
+                4.0 * g->u[k * ny + j]);
+            g->r[k * ny + j] = res;
+            if (fabs(res) > max_r) {
+                max_r = fabs(res);
+            }
+        }
+    }
+
+    return max_r;
+}
+
+// Сужение невязки на грубую сетку (полное взвешивание, правая часть * 4
+// из-за удвоенного шага). Начальная поправка на грубой сетке нулевая.
+void mg_restrict(mg_level_t* fine, mg_level_t* coarse, int rank, int size) {
+    int ny = fine->ny;
+    int cny = coarse->ny;
+
+    exchange_rows(fine->r, fine->rows, ny, rank, size);
+    for (int i = 0; i < (coarse->rows + 2) * cny; i++) {
+        coarse->u[i] = 0.0;
+        coarse->f[i] = 0.0;
+    }
+    for (int kc = 1; kc <= coarse->rows; kc++) {
+        int k = 2 * (coarse->lo - 1 + kc) - (fine->lo - 1);
+        double* r = fine->r;
+        for (int jc = 1; jc < cny - 1; jc++) {
+            int j = 2 * jc;
+            double fw = 4.0 * r[k * ny + j] +
+                        2.0 * (r[(k - 1) * ny + j] + r[(k + 1) * ny + j] +
+                               r[k * ny + j - 1] + r[k * ny + j + 1]) +
+                        r[(k - 1) * ny + j - 1] + r[(k - 1) * ny + j + 1] +
+                        r[(k + 1) * ny + j - 1] + r[(k + 1) * ny + j + 1];
+            coarse->f[kc * cny + jc] = 4.0 * fw / 16.0;
+        }
+    }
+}
+
+// Билинейная интерполяция поправки с грубой сетки и её добавление к решению
+void mg_prolongate(mg_level_t* coarse, mg_level_t* fine, int rank, int size) {
+    int ny = fine->ny;
+    int cny = coarse->ny;
+    double* e = coarse->u;
+
+    exchange_rows(e, coarse->rows, cny, rank, size);
+    for (int k = 1; k <= fine->rows; k++) {
+        int gi = fine->lo - 1 + k;
+        int kc = gi / 2 - (coarse->lo - 1);
+        int wi = gi % 2;
+        for (int j = 1; j < ny - 1; j++) {
+            int jc = j / 2, wj = j % 2;
+            fine->u[k * ny + j] += 0.25 * (e[kc * cny + jc] + e[(kc + wi) * cny + jc] +
+                                           e[kc * cny + jc + wj] + e[(kc + wi) * cny + jc + wj]);
+        }
+    }
+}
+
+// V-цикл начиная с уровня l
+void mg_v_cycle(mg_level_t* levels, int l, int num_levels, int rank, int size) {
+    mg_level_t* g = &levels[l];
+
+    if (l == num_levels - 1) {
+        // Самая грубая сетка: сглаживаем почти до сходимости
+        for (int iter = 0; iter < MG_COARSE_ITER; iter++) {
+            double local_diff = mg_smooth(g, rank, size);
+            double diff;
+            MPI_Allreduce(&local_diff, &diff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            if (diff < TOLERANCE * 1e-3) {
+                break;
+            }
+        }
+        return;
+    }
+
+    for (int s = 0; s < MG_PRE; s++) {
+        mg_smooth(g, rank, size);
+    }
+    mg_residual(g, rank, size);
+    mg_restrict(g, &levels[l + 1], rank, size);
+
+    mg_v_cycle(levels, l + 1, num_levels, rank, size);
+
+    mg_prolongate(&levels[l + 1], g, rank, size);
+    for (int s = 0; s < MG_POST; s++) {
+        mg_smooth(g, rank, size);
+    }
+}
+
+// Распределённый многосеточный решатель. Внутренние строки делятся на полосы
+// (допускается неравномерное деление). Сетка огрубляется вдвое, пока nx-1 и
+// ny-1 чётные и у каждого процесса остаётся хотя бы одна строка.
+// V-циклы выполняются до max |r| < TOLERANCE. Если output не NULL, решение
+// записывается в этот файл. Возвращает число V-циклов.
+int multigrid_wave(int nx, int ny, int rank, int size, double boundary_value, const char* output) {
+    int max_levels = 1;
+    for (int n = nx, m = ny; (n - 1) % 2 == 0 && (m - 1) % 2 == 0 && n > 3 && m > 3; n = (n + 1) / 2, m = (m + 1) / 2) {
+        max_levels++;
+    }
+
+    mg_level_t* levels = malloc(max_levels * sizeof(mg_level_t));
+    int num_levels = 0;
+    for (int l = 0; l < max_levels; l++) {
+        mg_level_t* g = &levels[l];
+        if (l == 0) {
+            g->nx = nx;
+            g->ny = ny;
+            row_range(nx - 2, rank, size, &g->lo, &g->hi);
+        } else {
+            g->nx = (levels[l - 1].nx + 1) / 2;
+            g->ny = (levels[l - 1].ny + 1) / 2;
+            g->lo = (levels[l - 1].lo + 1) / 2;
+            g->hi = (levels[l - 1].hi + 1) / 2;
+        }
+        g->rows = g->hi - g->lo;
+
+        int min_rows;
+        MPI_Allreduce(&g->rows, &min_rows, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (min_rows < 1) {
+            break;
+        }
+        g->u = calloc((g->rows + 2) * g->ny, sizeof(double));
+        g->f = calloc((g->rows + 2) * g->ny, sizeof(double));
+        g->r = calloc((g->rows + 2) * g->ny, sizeof(double));
+        num_levels++;
+    }
+    if (num_levels == 0) {
+        if (rank == 0) {
+            printf("Too many processes for %d interior rows.\n", nx - 2);
+        }
+        free(levels);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Каждый процесс сам строит свою полосу по глобальным координатам
+    mg_level_t* g = &levels[0];
+    initialize_block(g->u, g->rows + 2, ny, g->lo - 1, 0, nx, ny, boundary_value);
+    for (int k = 0; k < g->rows + 2; k++) {
+        for (int j = 0; j < ny; j++) {
+            g->f[k * ny + j] = f((double)(g->lo - 1 + k) / nx, (double)j / ny);
+        }
+    }
+
+    if (rank == 0) {
+        printf("Multigrid: %d levels, coarsest grid %dx%d\n",
+               num_levels, levels[num_levels - 1].nx, levels[num_levels - 1].ny);
+        if (num_levels == 1) {
+            printf("No coarsening possible: use nx-1 and ny-1 divisible by a power of two.\n");
+        }
+    }
+
+    int cycle;
+    double local_res = mg_residual(g, rank, size);
+    double res;
+    MPI_Allreduce(&local_res, &res, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    for (cycle = 0; cycle < MAX_ITER && res >= TOLERANCE; cycle++) {
+        mg_v_cycle(levels, 0, num_levels, rank, size);
+        local_res = mg_residual(g, rank, size);
+        MPI_Allreduce(&local_res, &res, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+
+    if (rank == 0) {
+        printf("V-cycles: %d, residual: %e\n", cycle, res);
+    }
+
+    if (output != NULL) {
+        write_plate(output, g->u, g->rows + 2, ny, g->lo == 1 ? 0 : 1, g->hi == nx - 1 ? g->rows + 2 : g->rows + 1,
+                    0, ny, g->lo - 1, 0, nx, ny, MPI_COMM_WORLD);
+    }
+
+    for (int l = 0; l < num_levels; l++) {
+        free(levels[l].u);
+        free(levels[l].f);
+        free(levels[l].r);
+    }
+    free(levels);
+    return cycle;
+}
+
+// Итерация Якоби в прямоугольнике [i0, i1) x [j0, j1) локального блока с шагом
+// строки ld. (gi0, gj0) — глобальные координаты локальной точки (0, 0).
+// Возвращает сумму |dst - src|.
+double jacobi_block(const double* src, double* dst, int i0, int i1, int j0, int j1, int ld,
+                    int gi0, int gj0, int nx, int ny) {
+    double diff = 0.0;
+
+    #pragma omp parallel for reduction(+:diff) schedule(static) if (i1 - i0 > 1)
+    for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+            dst[i * ld + j] = 0.25 * (
+                src[(i - 1) * ld + j] +
+                src[(i + 1) * ld + j] +
+                src[i * ld + j - 1] +
+                src[i * ld + j + 1] -
+                f((double)(gi0 + i) / nx, (double)(gj0 + j) / ny));
+            diff += fabs(dst[i * ld + j] - src[i * ld + j]);
+        }
+    }
+
+    return diff;
+}
+
+// Та же итерационная схема на двумерной декартовой решётке процессов.
+// Внутренние точки делятся на блоки по строкам и по столбцам (допускается
+// неравномерное деление), каждый процесс сам строит свой блок с кольцом
+// соседних точек. Строки соседей передаются как есть, столбцы — производным
+// типом MPI_Type_vector. Обмен перекрывается со счётом внутренних точек, как
+// в gauss_seidel_wave. Объём обмена на процесс — 2 * (rows + cols) вместо
+// 2 * ny у полос и убывает с ростом числа процессов. Если output не NULL,
+// решение записывается в этот файл. Возвращает число итераций.
+int gauss_seidel_2d(int nx, int ny, int rank, int size, double boundary_value, const char* output) {
+    int dims[2] = {0, 0};
+    int periods[2] = {0, 0};
+    int coords[2];
+    MPI_Comm cart_comm;
+    MPI_Dims_create(size, 2, dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm);
+    MPI_Comm_rank(cart_comm, &rank);
+    MPI_Cart_coords(cart_comm, rank, 2, coords);
+
+    int up, down, left, right;
+    MPI_Cart_shift(cart_comm, 0, 1, &up, &down);
+    MPI_Cart_shift(cart_comm, 1, 1, &left, &right);
+
+    int i_lo, i_hi, j_lo, j_hi;
+    row_range(nx - 2, coords[0], dims[0], &i_lo, &i_hi);
+    row_range(ny - 2, coords[1], dims[1], &j_lo, &j_hi);
+    int rows = i_hi - i_lo;
+    int cols = j_hi - j_lo;
+    int ld = cols + 2;
+    if (rows < 1 || cols < 1) {
+        if (rank == 0) {
+            printf("Grid %dx%d is too small for %dx%d processes.\n", nx, ny, dims[0], dims[1]);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Локальная точка (i, j) — глобальная (i_lo - 1 + i, j_lo - 1 + j)
+    int gi0 = i_lo - 1;
+    int gj0 = j_lo - 1;
+    double* old_block = (double*)malloc((rows + 2) * ld * sizeof(double));
+    double* new_block = (double*)malloc((rows + 2) * ld * sizeof(double));
+    initialize_block(old_block, rows + 2, ld, gi0, gj0, nx, ny, boundary_value);
+    initialize_block(new_block, rows + 2, ld, gi0, gj0, nx, ny, boundary_value);
+
+    MPI_Datatype column_type;
+    MPI_Type_vector(rows, 1, ld, MPI_DOUBLE, &column_type);
+    MPI_Type_commit(&column_type);
+
+    int halo_doubles = (up != MPI_PROC_NULL) * cols + (down != MPI_PROC_NULL) * cols +
+                       (left != MPI_PROC_NULL) * rows + (right != MPI_PROC_NULL) * rows;
+    int max_halo;
+    MPI_Reduce(&halo_doubles, &max_halo, 1, MPI_INT, MPI_MAX, 0, cart_comm);
+    if (rank == 0) {
+        printf("Process grid %dx%d, max halo per process: %d doubles (row strips: %d)\n",
+               dims[0], dims[1], max_halo, 2 * ny);
+    }
+
+    MPI_Request halo[8];
+    MPI_Request diff_request = MPI_REQUEST_NULL;
+    double local_diff = 0.0;
+    double global_diff = 0.0;
+    int converged = 0;
+
+    int iter = 0;
+    do {
+        double diff = 0.0;
+
+        // Крайние строки и столбцы блока — их ждут соседи
+        diff += jacobi_block(old_block, new_block, 1, 2, 1, cols + 1, ld, gi0, gj0, nx, ny);
+        if (rows > 1) {
+            diff += jacobi_block(old_block, new_block, rows, rows + 1, 1, cols + 1, ld, gi0, gj0, nx, ny);
+        }
+        if (rows > 2) {
+            diff += jacobi_block(old_block, new_block, 2, rows, 1, 2, ld, gi0, gj0, nx, ny);
+            if (cols > 1) {
+                diff += jacobi_block(old_block, new_block, 2, rows, cols, cols + 1, ld, gi0, gj0, nx, ny);
             }
         }
 
+        // Обмен: строки сверху/снизу, столбцы слева/справа
+        MPI_Irecv(new_block + 1, cols, MPI_DOUBLE, up, 0, cart_comm, &halo[0]);
+        MPI_Irecv(new_block + (rows + 1) * ld + 1, cols, MPI_DOUBLE, down, 1, cart_comm, &halo[1]);
+        MPI_Irecv(new_block + ld, 1, column_type, left, 2, cart_comm, &halo[2]);
+        MPI_Irecv(new_block + ld + cols + 1, 1, column_type, right, 3, cart_comm, &halo[3]);
+        MPI_Isend(new_block + ld + 1, cols, MPI_DOUBLE, up, 1, cart_comm, &halo[4]);
+        MPI_Isend(new_block + rows * ld + 1, cols, MPI_DOUBLE, down, 0, cart_comm, &halo[5]);
+        MPI_Isend(new_block + ld + 1, 1, column_type, left, 3, cart_comm, &halo[6]);
+        MPI_Isend(new_block + ld + cols, 1, column_type, right, 2, cart_comm, &halo[7]);
+
+        // Внутренние точки, пока идёт обмен
+        diff += jacobi_block(old_block, new_block, 2, rows, 2, cols, ld, gi0, gj0, nx, ny);
+
+        // Сравнение разницы на всех процессах: результат предыдущей итерации
+        if (iter > 0) {
+            MPI_Wait(&diff_request, MPI_STATUS_IGNORE);
+            converged = global_diff <= TOLERANCE;
+        }
+
+        MPI_Waitall(8, halo, MPI_STATUSES_IGNORE);
+
+        double* tmp = old_block;
+        old_block = new_block;
+        new_block = tmp;
+
+        local_diff = diff;
+        MPI_Iallreduce(&local_diff, &global_diff, 1, MPI_DOUBLE, MPI_SUM, cart_comm, &diff_request);
+
         iter++;
-    } while (global_diff > TOLERANCE && iter < MAX_ITER);
+    } while (!converged && iter < MAX_ITER);
 
-    free(new_plate);
+    MPI_Wait(&diff_request, MPI_STATUS_IGNORE);
+
+    // Крайние блоки пишут и свою часть границы пластинки
+    if (output != NULL) {
+        write_plate(output, old_block, rows + 2, ld, i_lo == 1 ? 0 : 1, i_hi == nx - 1 ? rows + 2 : rows + 1,
+                    j_lo == 1 ? 0 : 1, j_hi == ny - 1 ? cols + 2 : cols + 1, gi0, gj0, nx, ny, cart_comm);
+    }
+
+    MPI_Type_free(&column_type);
+    MPI_Comm_free(&cart_comm);
+    free(old_block);
+    free(new_block);
+    return iter;
 }
 
 int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
+    // Обмен границами идёт из omp master, поэтому нужен FUNNELED
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "MPI_THREAD_FUNNELED is not supported\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (rank == 0) {
+        printf("MPI processes: %d, OpenMP threads per process: %d\n", size, omp_get_max_threads());
+    }
 
-    int nx = 100; // Размер сетки по x
-    int ny = 100; // Размер сетки по y
+    // mpirun ./3 [nx] [ny] [gs|mg|tiled|2d] [tile_steps] [output_file]
+    int nx = argc > 1 ? atoi(argv[1]) : 100; // Размер сетки по x
+    int ny = argc > 2 ? atoi(argv[2]) : nx;  // Размер сетки по y
+    const char* method = argc > 3 ? argv[3] : "gs";
+    int tile_steps = argc > 4 ? atoi(argv[4]) : TILE_STEPS;
+    const char* output = argc > 5 ? argv[5] : NULL; // Файл для решения (MPI-IO)
     double boundary_value = 100.0; // Граничное значение температуры
 
-    if (nx % size != 0) {
+    if (strcmp(method, "mg") == 0) {
+        double start_time = MPI_Wtime();
+        multigrid_wave(nx, ny, rank, size, boundary_value, output);
+        double end_time = MPI_Wtime();
+
         if (rank == 0) {
-            printf("The number of processes must divide the grid size evenly.\n");
+            printf("Elapsed time: %f seconds\n", end_time - start_time);
         }
-        MPI_Abort(MPI_COMM_WORLD, 1);
-    }
 
-    int local_nx = nx / size + 2; // +2 для соседних строк
-    double* local_plate = (double*)malloc(local_nx * ny * sizeof(double));
+        MPI_Finalize();
+        return 0;
+    }
 
-    if (rank == 0) {
-        double* global_plate = (double*)malloc(nx * ny * sizeof(double));
-        initialize_plate(global_plate, nx, ny, boundary_value);
+    if (strcmp(method, "2d") == 0) {
+        double start_time = MPI_Wtime();
+        int iter = gauss_seidel_2d(nx, ny, rank, size, boundary_value, output);
+        double end_time = MPI_Wtime();
 
-        // Раздача блоков остальным процессам
-        for (int p = 1; p < size; p++) {
-            MPI_Send(global_plate + p * (nx / size - 1) * ny, (nx / size + 2) * ny, MPI_DOUBLE, p, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            double updates = (double)(nx - 2) * (ny - 2) * iter;
+            printf("Iterations: %d\n", iter);
+            printf("Elapsed time: %f seconds\n", end_time - start_time);
+            printf("GFLOP/s: %f, GB/s: %f\n", STENCIL_FLOPS * updates / (end_time - start_time) / 1e9,
+                   STENCIL_BYTES * updates / (end_time - start_time) / 1e9);
         }
 
-            // Скопировать свой блок
-        for (int i = 0; i < local_nx; i++) {
-            for (int j = 0; j < ny; j++) {
-                local_plate[i * ny + j] = global_plate[i * ny + j];
-            }
-        }
+        MPI_Finalize();
+        return 0;
+    }
 
-        free(global_plate);
-    } else {
-        MPI_Recv(local_plate, local_nx * ny, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (nx - 2 < size) {
+        if (rank == 0) {
+            printf("The number of processes must not exceed the number of interior rows.\n");
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+    // Полоса внутренних строк [lo, hi) и по одной соседней строке; каждый
+    // процесс строит её сам по глобальным координатам
+    int lo, hi;
+    row_range(nx - 2, rank, size, &lo, &hi);
+    int rows = hi - lo;
+    double* local_plate = (double*)malloc((rows + 2) * ny * sizeof(double));
+    initialize_block(local_plate, rows + 2, ny, lo - 1, 0, nx, ny, boundary_value);
+
+    int iter;
     double start_time = MPI_Wtime();
-    gauss_seidel_wave(local_plate, nx, ny, rank, size, boundary_value);
+    if (strcmp(method, "tiled") == 0) {
+        iter = gauss_seidel_wave_tiled(local_plate, rows, lo - 1, nx, ny, rank, size, tile_steps);
+    } else {
+        iter = gauss_seidel_wave(local_plate, rows, lo - 1, nx, ny, rank, size, boundary_value);
+    }
     double end_time = MPI_Wtime();
 
     if (rank == 0) {
+        double updates = (double)(nx - 2) * (ny - 2) * iter;
+        printf("Iterations: %d\n", iter);
         printf("Elapsed time: %f seconds\n", end_time - start_time);
+        printf("GFLOP/s: %f, GB/s: %f\n", STENCIL_FLOPS * updates / (end_time - start_time) / 1e9,
+               STENCIL_BYTES * updates / (end_time - start_time) / 1e9);
+    }
+
+    // Первый и последний процессы пишут и граничные строки пластинки
+    if (output != NULL) {
+        write_plate(output, local_plate, rows + 2, ny, rank == 0 ? 0 : 1, rank == size - 1 ? rows + 2 : rows + 1,
+                    0, ny, lo - 1, 0, nx, ny, MPI_COMM_WORLD);
     }
 
     free(local_plate);
     MPI_Finalize();
     return 0;
-}
\ No newline at end of file
+}
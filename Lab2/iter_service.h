@@ -0,0 +1,27 @@
+#ifndef _ITER_SERVICE_H_
+#define _ITER_SERVICE_H_
+
+// Общее для режима iter в 1a.c, 1bN2.c и 1c.c
+
+#include <stdio.h>
+
+// Элемент 0..9, зависящий только от глобальных индексов: каждый процесс
+// генерирует свою часть сам, результат не зависит от числа процессов
+static inline int GenValue(int i, int j) {
+    unsigned h = (unsigned)i * 2654435761u ^ (unsigned)j * 40503u;
+    h ^= h >> 15;
+    return (int)((h * 2246822519u) >> 16) % 10;
+}
+
+// Задержки k >= 1 итераций на ранге 0: среднее, минимум и максимум
+static inline void PrintLatency(double *lat, int k) {
+    double sum = 0.0, lo = 0.0, hi = 0.0;
+    for (int t = 0; t < k; t++) {
+        sum += lat[t];
+        lo = t == 0 || lat[t] < lo ? lat[t] : lo;
+        hi = t == 0 || lat[t] > hi ? lat[t] : hi;
+    }
+    printf("Latency per iteration: mean %f, min %f, max %f seconds\n", sum / k, lo, hi);
+}
+
+#endif
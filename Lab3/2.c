@@ -1,100 +1,447 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <omp.h>
 
-// Определение размеров сетки
+// Размеры сетки по умолчанию (задаются аргументами командной строки)
 #define NX 20  // Количество точек в направлении x
 #define NY 20  // Количество точек в направлении y
 #define MAX_ITER 10000  // Максимальное количество итераций
 #define TOL 1e-6  // Точность сходимости
+#define ALIGN 64  // Выравнивание строк сетки (байт, размер кэш-линии)
+#define PRINT_MAX 20  // Решение печатается только для небольших сеток
+#define TILE_SWEEPS 4  // Итераций на одну полосу в режиме временной блокировки
+#define TILE_BYTES (1 << 20)  // Объём полосы (u и f), который должен помещаться в кэш
+#define STENCIL_FLOPS 6  // Операций с плавающей точкой на обновление точки
+#define STENCIL_BYTES 24  // Номинальный трафик на обновление: чтение u и f, запись u
+#define MG_PRE 2  // Сглаживающих итераций до спуска на грубую сетку
+#define MG_POST 2  // Сглаживающих итераций после коррекции
+#define MG_MIN 2  // Минимальное число интервалов грубой сетки по каждому направлению
+#define MG_COARSE_ITER 1000  // Предел итераций на самой грубой сетке
+
+// Индекс точки (i, j) в сетке с шагом строки ld
+#define IDX(i, j, ld) ((size_t)(i) * (ld) + (j))
+
+// Шаг строки: ny+1 точек, округлённых вверх до кэш-линии
+int grid_ld(int ny) {
+    int per_line = ALIGN / sizeof(double);
+    return (ny + 1 + per_line - 1) / per_line * per_line;
+}
+
+// Выделение выровненной сетки (nx+1) x ld в куче
+double* alloc_grid(int nx, int ld) {
+    double* g = NULL;
+    if (posix_memalign((void**)&g, ALIGN, (size_t)(nx + 1) * ld * sizeof(double)) != 0) {
+        return NULL;
+    }
+    return g;
+}
 
 // Функция для инициализации сетки с граничными условиями
-void initialize_grid(double u[NX+1][NY+1], double c) {
+void initialize_grid(double* u, int nx, int ny, int ld, double c) {
+    // Инициализация внутренних точек (начальное приближение);
+    // параллельно, чтобы страницы легли рядом с потоками, которые их обновляют
+    #pragma omp parallel for
+    for (int i = 0; i <= nx; i++) {
+        for (int j = 0; j < ld; j++) {
+            u[IDX(i, j, ld)] = 0.0; // Начальное приближение
+        }
+    }
+
     // Установка граничных условий (Дирихле)
-    for (int i = 0; i <= NX; i++) {
-        u[i][0] = c;  // u(x, 0) = c
-        u[i][NY] = c; // u(x, 1) = c
+    for (int i = 0; i <= nx; i++) {
+        u[IDX(i, 0, ld)] = c;  // u(x, 0) = c
+        u[IDX(i, ny, ld)] = c; // u(x, 1) = c
     }
-    for (int j = 0; j <= NY; j++) {
-        u[0][j] = c;  // u(0, y) = c
-        u[NX][j] = c; // u(1, y) = c
+    for (int j = 0; j <= ny; j++) {
+        u[IDX(0, j, ld)] = c;  // u(0, y) = c
+        u[IDX(nx, j, ld)] = c; // u(1, y) = c
     }
+}
 
-    // Инициализация внутренних точек (начальное приближение)
-    for (int i = 1; i < NX; i++) {
-        for (int j = 1; j < NY; j++) {
-            u[i][j] = 0.0; // Начальное приближение
+// Полуитерация Гаусса-Зейделя: обновление точек цвета color ((i + j) % 2 == color)
+// в строках [i0, i1). Возвращает max |u_new - u_old| по обновлённым точкам.
+double rb_update_rows(double* u, const double* f, int i0, int i1, int ny, int ld, int color) {
+    double max_diff = 0.0;
+
+    for (int i = i0; i < i1; i++) {
+        for (int j = 1 + (i + color + 1) % 2; j < ny; j += 2) {
+            double old_value = u[IDX(i, j, ld)];
+            double new_value = 0.25 * (u[IDX(i - 1, j, ld)] + u[IDX(i + 1, j, ld)] +
+                                       u[IDX(i, j - 1, ld)] + u[IDX(i, j + 1, ld)] -
+                                       f[IDX(i, j, ld)]);
+            u[IDX(i, j, ld)] = new_value;
+            double diff = fabs(new_value - old_value);
+            if (diff > max_diff) {
+                max_diff = diff;
+            }
         }
     }
+
+    return max_diff;
 }
 
-// Метод Гаусса-Зейделя для решения уравнения
-void gauss_seidel(double u[NX+1][NY+1], double f[NX+1][NY+1]) {
-    // Обновление значений сетки с использованием метода Гаусса-Зейделя
-    #pragma omp parallel for collapse(2) shared(u, f)
-    for (int i = 1; i < NX; i++) {
-        for (int j = 1; j < NY; j++) {
-            u[i][j] = 0.25 * (u[i-1][j] + u[i+1][j] + u[i][j-1] + u[i][j+1] - f[i][j]);
+// Метод Гаусса-Зейделя для решения уравнения (красно-чёрное упорядочивание).
+// Точки одного цвета зависят только от точек другого цвета, поэтому каждая
+// полуитерация параллельна без гонок. Максимальное изменение считается прямо
+// в проходе, без копии сетки. Возвращает max |u_new - u_old|.
+double gauss_seidel(double* u, const double* f, int nx, int ny, int ld) {
+    double max_diff = 0.0;
+
+    for (int color = 0; color < 2; color++) {
+        #pragma omp parallel for reduction(max:max_diff) schedule(static)
+        for (int i = 1; i < nx; i++) {
+            double diff = rb_update_rows(u, f, i, i + 1, ny, ld, color);
+            if (diff > max_diff) {
+                max_diff = diff;
+            }
         }
     }
+
+    return max_diff;
 }
 
-int main() {
-    double u[NX+1][NY+1]; // Сетка для решения
-    double f[NX+1][NY+1]; // Источник (для примера, считаем его нулевым)
+// sweeps итераций красно-чёрного Гаусса-Зейделя с временной блокировкой
+// (split tiling). Строки делятся на полосы высотой ~TILE_BYTES, и каждая
+// полоса проходит все 2*sweeps полуитераций, пока лежит в кэше:
+//  1) полосы параллельно: шаг s обновляет строки [lo + s, hi - s) — трапеция,
+//     сужающаяся от внутренних границ полос;
+//  2) стыки параллельно: шаг s обновляет [x - s, x + s) вокруг границы x —
+//     оставшиеся перевёрнутые треугольники.
+// Каждая точка получает ровно ту же последовательность обновлений, что и в
+// gauss_seidel, поэтому результат совпадает с обычными итерациями.
+// Возвращает max |u_new - u_old| за последнюю итерацию.
+double gauss_seidel_tiled(double* u, const double* f, int nx, int ny, int ld, int sweeps) {
+    int steps = 2 * sweeps;
+    int height = TILE_BYTES / (2 * ld * (int)sizeof(double));
+    if (height < 2 * steps) {
+        height = 2 * steps;
+    }
+    int num_tiles = (nx - 1) / height;
+    double max_diff = 0.0;
 
-    // Инициализация сетки
-    double c = 100.0; // Значение граничного условия
-    initialize_grid(u, c);
+    if (num_tiles < 2) {
+        for (int s = 0; s < sweeps; s++) {
+            max_diff = gauss_seidel(u, f, nx, ny, ld);
+        }
+        return max_diff;
+    }
 
-    // Инициализация источника (если нужно)
-    for (int i = 1; i < NX; i++) {
-        for (int j = 1; j < NY; j++) {
-            f[i][j] = 0.0; // Например, f(x, y) = 0
+    // Фаза 1: трапеции внутри полос (последняя полоса забирает остаток строк)
+    #pragma omp parallel for reduction(max:max_diff) schedule(static)
+    for (int t = 0; t < num_tiles; t++) {
+        int lo = 1 + t * height;
+        int hi = t == num_tiles - 1 ? nx : lo + height;
+        for (int s = 0; s < steps; s++) {
+            int i0 = t > 0 ? lo + s : lo;
+            int i1 = t < num_tiles - 1 ? hi - s : hi;
+            double diff = rb_update_rows(u, f, i0, i1, ny, ld, s % 2);
+            if (s >= steps - 2 && diff > max_diff) {
+                max_diff = diff;
+            }
         }
     }
 
-    // Итерации до сходимости или максимального числа итераций
-    for (int iter = 0; iter < MAX_ITER; iter++) {
-        double max_diff = 0.0;
-
-        // Сохраняем старые значения для вычисления сходимости
-        double old_u[NX+1][NY+1];
-        for (int i = 0; i <= NX; i++) {
-            for (int j = 0; j <= NY; j++) {
-                old_u[i][j] = u[i][j];
+    // Фаза 2: треугольники на стыках полос
+    #pragma omp parallel for reduction(max:max_diff) schedule(static)
+    for (int t = 1; t < num_tiles; t++) {
+        int x = 1 + t * height;
+        for (int s = 1; s < steps; s++) {
+            double diff = rb_update_rows(u, f, x - s, x + s, ny, ld, s % 2);
+            if (s >= steps - 2 && diff > max_diff) {
+                max_diff = diff;
             }
         }
+    }
 
-        // Выполняем итерацию Гаусса-Зейделя
-        gauss_seidel(u, f);
+    return max_diff;
+}
 
-        // Проверка сходимости
-        for (int i = 1; i < NX; i++) {
-            for (int j = 1; j < NY; j++) {
-                double diff = fabs(u[i][j] - old_u[i][j]);
-                if (diff > max_diff) {
-                    max_diff = diff;
-                }
-            }
+// Итерации Гаусса-Зейделя до сходимости или max_iter. При tile_sweeps > 0
+// итерации выполняются блоками по tile_sweeps с временной блокировкой (последний
+// блок короче, если до max_iter осталось меньше), и сходимость проверяется
+// после каждого блока.
+// Возвращает число итераций, в *final_diff — последнее максимальное изменение.
+int solve_gauss_seidel(double* u, const double* f, int nx, int ny, int ld, int max_iter,
+                       int tile_sweeps, double* final_diff) {
+    int iter;
+    double max_diff = 0.0;
+
+    for (iter = 0; iter < max_iter;) {
+        // Выполняем итерацию Гаусса-Зейделя и сразу получаем максимальное изменение
+        if (tile_sweeps > 0) {
+            // Последний блок укорачивается, чтобы не превысить max_iter
+            int sweeps = tile_sweeps < max_iter - iter ? tile_sweeps : max_iter - iter;
+            max_diff = gauss_seidel_tiled(u, f, nx, ny, ld, sweeps);
+            iter += sweeps;
+        } else {
+            max_diff = gauss_seidel(u, f, nx, ny, ld);
+            iter++;
         }
 
         // Если изменения меньше порога, завершить итерации
         if (max_diff < TOL) {
-            printf("Сходимость достигнута после %d итераций.\n", iter);
+            printf("Сходимость достигнута после %d итераций.\n", iter - 1);
             break;
         }
     }
 
-    // Вывод решения (можно распечатать или визуализировать)
-    printf("Решение сетки:\n");
-    for (int i = 0; i <= NX; i++) {
-        for (int j = 0; j <= NY; j++) {
-            printf("%f ", u[i][j]);
+    *final_diff = max_diff;
+    return iter;
+}
+
+// Уровень многосеточной иерархии: решение/поправка u, правая часть f, невязка r
+typedef struct {
+    int nx, ny, ld;
+    double* u;
+    double* f;
+    double* r;
+} grid_level_t;
+
+// Невязка r = f - (u[i-1][j] + u[i+1][j] + u[i][j-1] + u[i][j+1] - 4u[i][j])
+// во внутренних точках. Возвращает max |r|.
+double residual(const double* u, const double* f, double* r, int nx, int ny, int ld) {
+    double max_r = 0.0;
+
+    #pragma omp parallel for reduction(max:max_r) schedule(static)
+    for (int i = 1; i < nx; i++) {
+        for (int j = 1; j < ny; j++) {
+            double res = f[IDX(i, j, ld)] -
+                         (u[IDX(i - 1, j, ld)] + u[IDX(i + 1, j, ld)] +
+                          u[IDX(i, j - 1, ld)] + u[IDX(i, j + 1, ld)] - 4.0 * u[IDX(i, j, ld)]);
+            r[IDX(i, j, ld)] = res;
+            if (fabs(res) > max_r) {
+                max_r = fabs(res);
+            }
+        }
+    }
+
+    return max_r;
+}
+
+// Сужение невязки на грубую сетку (полное взвешивание). Шаг грубой сетки
+// вдвое больше, поэтому правая часть уравнения для поправки умножается на 4.
+// Начальная поправка на грубой сетке нулевая.
+void restrict_residual(const grid_level_t* fine, grid_level_t* coarse) {
+    const double* r = fine->r;
+    int ld = fine->ld;
+    int cld = coarse->ld;
+
+    #pragma omp parallel for schedule(static)
+    for (int ic = 0; ic <= coarse->nx; ic++) {
+        for (int jc = 0; jc < cld; jc++) {
+            coarse->u[IDX(ic, jc, cld)] = 0.0;
+            coarse->f[IDX(ic, jc, cld)] = 0.0;
+        }
+        if (ic == 0 || ic == coarse->nx) {
+            continue;
+        }
+        int i = 2 * ic;
+        for (int jc = 1; jc < coarse->ny; jc++) {
+            int j = 2 * jc;
+            double fw = 4.0 * r[IDX(i, j, ld)] +
+                        2.0 * (r[IDX(i - 1, j, ld)] + r[IDX(i + 1, j, ld)] +
+                               r[IDX(i, j - 1, ld)] + r[IDX(i, j + 1, ld)]) +
+                        r[IDX(i - 1, j - 1, ld)] + r[IDX(i - 1, j + 1, ld)] +
+                        r[IDX(i + 1, j - 1, ld)] + r[IDX(i + 1, j + 1, ld)];
+            coarse->f[IDX(ic, jc, cld)] = 4.0 * fw / 16.0;
+        }
+    }
+}
+
+// Билинейная интерполяция поправки с грубой сетки и её добавление к решению
+void prolongate_correction(const grid_level_t* coarse, grid_level_t* fine) {
+    const double* e = coarse->u;
+    int ld = fine->ld;
+    int cld = coarse->ld;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 1; i < fine->nx; i++) {
+        int ic = i / 2, wi = i % 2;
+        for (int j = 1; j < fine->ny; j++) {
+            int jc = j / 2, wj = j % 2;
+            fine->u[IDX(i, j, ld)] += 0.25 * (e[IDX(ic, jc, cld)] + e[IDX(ic + wi, jc, cld)] +
+                                              e[IDX(ic, jc + wj, cld)] + e[IDX(ic + wi, jc + wj, cld)]);
+        }
+    }
+}
+
+// V-цикл начиная с уровня l: сглаживание, спуск невязки, коррекция, сглаживание
+void v_cycle(grid_level_t* levels, int l, int num_levels) {
+    grid_level_t* g = &levels[l];
+
+    if (l == num_levels - 1) {
+        // Самая грубая сетка: решаем сглаживателем почти до сходимости
+        for (int iter = 0; iter < MG_COARSE_ITER; iter++) {
+            if (gauss_seidel(g->u, g->f, g->nx, g->ny, g->ld) < TOL * 1e-3) {
+                break;
+            }
+        }
+        return;
+    }
+
+    for (int s = 0; s < MG_PRE; s++) {
+        gauss_seidel(g->u, g->f, g->nx, g->ny, g->ld);
+    }
+    residual(g->u, g->f, g->r, g->nx, g->ny, g->ld);
+    restrict_residual(g, &levels[l + 1]);
+
+    v_cycle(levels, l + 1, num_levels);
+
+    prolongate_correction(&levels[l + 1], g);
+    for (int s = 0; s < MG_POST; s++) {
+        gauss_seidel(g->u, g->f, g->nx, g->ny, g->ld);
+    }
+}
+
+// Освобождение уровней, выделенных multigrid (u и f уровня 0 — чужие)
+static void free_levels(grid_level_t* levels, int num_levels) {
+    free(levels[0].r);
+    for (int l = 1; l < num_levels; l++) {
+        free(levels[l].u);
+        free(levels[l].f);
+        free(levels[l].r);
+    }
+    free(levels);
+}
+
+// Многосеточный решатель. Сетка огрубляется вдвое, пока nx и ny чётные и
+// не меньше 2*MG_MIN. Итерации (V-циклы) идут до max |r| < TOL.
+// Возвращает число выполненных V-циклов, в *final_res — итоговую невязку;
+// -1, если грубых уровней нет (нечётные nx, ny) или не хватило памяти.
+int multigrid(double* u, double* f, int nx, int ny, int ld, int max_iter, double* final_res) {
+    int num_levels = 1;
+    for (int cx = nx, cy = ny; cx % 2 == 0 && cy % 2 == 0 && cx / 2 >= MG_MIN && cy / 2 >= MG_MIN;
+         cx /= 2, cy /= 2) {
+        num_levels++;
+    }
+    if (num_levels == 1) {
+        fprintf(stderr, "Многосеточный метод: нет грубого уровня для сетки %dx%d "
+                "(nx и ny должны быть чётными и не меньше %d)\n", nx + 1, ny + 1, 2 * MG_MIN);
+        return -1;
+    }
+
+    grid_level_t* levels = malloc(num_levels * sizeof(grid_level_t));
+    levels[0] = (grid_level_t){nx, ny, ld, u, f, alloc_grid(nx, ld)};
+    for (int l = 1; l < num_levels; l++) {
+        int cx = levels[l - 1].nx / 2, cy = levels[l - 1].ny / 2, cld = grid_ld(cy);
+        levels[l] = (grid_level_t){cx, cy, cld, alloc_grid(cx, cld), alloc_grid(cx, cld), alloc_grid(cx, cld)};
+    }
+    int allocated = levels[0].r != NULL;
+    for (int l = 1; l < num_levels; l++) {
+        allocated = allocated && levels[l].u != NULL && levels[l].f != NULL && levels[l].r != NULL;
+    }
+    if (!allocated) {
+        fprintf(stderr, "Не удалось выделить память под уровни многосеточного метода\n");
+        free_levels(levels, num_levels);
+        return -1;
+    }
+    for (int l = 0; l < num_levels; l++) {
+        size_t count = (size_t)(levels[l].nx + 1) * levels[l].ld;
+        for (size_t k = 0; k < count; k++) {
+            levels[l].r[k] = 0.0;
+            if (l > 0) {
+                levels[l].u[k] = 0.0;
+                levels[l].f[k] = 0.0;
+            }
+        }
+    }
+    printf("Многосеточный метод: %d уровней, самая грубая сетка %dx%d\n",
+           num_levels, levels[num_levels - 1].nx + 1, levels[num_levels - 1].ny + 1);
+
+    int cycle;
+    double res = residual(u, f, levels[0].r, nx, ny, ld);
+    for (cycle = 0; cycle < max_iter && res >= TOL; cycle++) {
+        v_cycle(levels, 0, num_levels);
+        res = residual(u, f, levels[0].r, nx, ny, ld);
+    }
+    if (res < TOL) {
+        printf("Сходимость достигнута после %d V-циклов.\n", cycle);
+    }
+    *final_res = res;
+
+    free_levels(levels, num_levels);
+    return cycle;
+}
+
+int main(int argc, char* argv[]) {
+    // Размеры сетки и метод: ./2 [nx] [ny] [max_iter] [gs|mg|tiled] [tile_sweeps]
+    int nx = argc > 1 ? atoi(argv[1]) : NX;
+    int ny = argc > 2 ? atoi(argv[2]) : (argc > 1 ? nx : NY);
+    int max_iter = argc > 3 ? atoi(argv[3]) : MAX_ITER;
+    const char* method = argc > 4 ? argv[4] : "gs";
+    int tile_sweeps = argc > 5 ? atoi(argv[5]) : TILE_SWEEPS;
+    if (nx < 2 || ny < 2 || max_iter < 1 || tile_sweeps < 1 ||
+        (strcmp(method, "gs") != 0 && strcmp(method, "mg") != 0 && strcmp(method, "tiled") != 0)) {
+        fprintf(stderr, "usage: %s [nx >= 2] [ny >= 2] [max_iter >= 1] [gs|mg|tiled] [tile_sweeps >= 1]\n",
+                argv[0]);
+        return 1;
+    }
+
+    int ld = grid_ld(ny);
+    double* u = alloc_grid(nx, ld); // Сетка для решения
+    double* f = alloc_grid(nx, ld); // Источник (для примера, считаем его нулевым)
+    if (u == NULL || f == NULL) {
+        fprintf(stderr, "Не удалось выделить память под сетку %dx%d\n", nx + 1, ny + 1);
+        free(u);
+        free(f);
+        return 1;
+    }
+
+    // Инициализация сетки
+    double c = 100.0; // Значение граничного условия
+    initialize_grid(u, nx, ny, ld, c);
+
+    // Инициализация источника (если нужно)
+    #pragma omp parallel for
+    for (int i = 0; i <= nx; i++) {
+        for (int j = 0; j < ld; j++) {
+            f[IDX(i, j, ld)] = 0.0; // Например, f(x, y) = 0
+        }
+    }
+
+    // Итерации до сходимости или максимального числа итераций
+    // (для многосеточного метода итерация — это один V-цикл)
+    int iter;
+    double max_diff = 0.0;
+    double start = omp_get_wtime();
+    if (strcmp(method, "mg") == 0) {
+        iter = multigrid(u, f, nx, ny, ld, max_iter, &max_diff);
+        if (iter < 0) {
+            free(u);
+            free(f);
+            return 1;
+        }
+    } else if (strcmp(method, "tiled") == 0) {
+        iter = solve_gauss_seidel(u, f, nx, ny, ld, max_iter, tile_sweeps, &max_diff);
+    } else {
+        iter = solve_gauss_seidel(u, f, nx, ny, ld, max_iter, 0, &max_diff);
+    }
+    double elapsed = omp_get_wtime() - start;
+
+    double points = (double)(nx - 1) * (ny - 1);
+    printf("Сетка %dx%d, потоков %d, итераций %d, max_diff %e\n",
+           nx + 1, ny + 1, omp_get_max_threads(), iter, max_diff);
+    printf("Elapsed time: %f seconds\n", elapsed);
+    printf("Sweeps/sec: %f, MLUP/s: %f\n", iter / elapsed, points * iter / elapsed / 1e6);
+    if (strcmp(method, "mg") != 0) {
+        printf("GFLOP/s: %f, GB/s: %f\n", STENCIL_FLOPS * points * iter / elapsed / 1e9,
+               STENCIL_BYTES * points * iter / elapsed / 1e9);
+    }
+
+    // Вывод решения (только для небольших сеток)
+    if (nx <= PRINT_MAX && ny <= PRINT_MAX) {
+        printf("Решение сетки:\n");
+        for (int i = 0; i <= nx; i++) {
+            for (int j = 0; j <= ny; j++) {
+                printf("%f ", u[IDX(i, j, ld)]);
+            }
+            printf("\n");
         }
-        printf("\n");
     }
 
+    free(u);
+    free(f);
     return 0;
 }